@@ -0,0 +1,273 @@
+// Standalone micro benchmarks for memory::gc / memory::page.
+// Each workload runs in its own process and reports one JSON object per line.
+//
+//   yakkai_gc_bench [scale] [workload...]
+//
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+#include <cstddef>
+
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "yakkai/memory/gc.hpp"
+#include "yakkai/node.hpp"
+
+
+namespace
+{
+    using namespace yakkai;
+    using clock_type = std::chrono::steady_clock;
+
+
+    // opaque objects to make pages of various block sizes
+    template<std::size_t N>
+    struct blob : public node
+    {
+        blob()
+            : node( node_type::e_none )
+        {}
+
+        unsigned char payload[N];
+    };
+
+
+    //
+    struct context
+    {
+        context( void volatile const* const stack_base )
+            : gc( std::make_shared<memory::gc>( stack_base ) )
+            , allocated_num( 0 )
+        {
+            gc->cha( [this]( std::function<void (node*)> const& marker ) {
+                    for( auto&& n : roots ) {
+                        marker( n );
+                    }
+                } );
+
+            gc->on_collected( [this]( memory::collection_info const& info ) {
+                    pauses.push_back( info.pause );
+                } );
+        }
+
+        template<typename T, typename... Args>
+        auto make( Args&&... args )
+            -> T*
+        {
+            ++allocated_num;
+            return gc->template make_object<T>( std::forward<Args>( args )... );
+        }
+
+        auto make_cons( node* const car, node* const cdr )
+            -> cons*
+        {
+            return make<cons>( car, cdr );
+        }
+
+        std::shared_ptr<memory::gc> gc;
+        std::vector<node*> roots;
+
+        std::size_t allocated_num;
+        std::vector<std::chrono::nanoseconds> pauses;
+    };
+
+
+    // short-lived objects only
+    auto churn( context& ctx, std::size_t const scale )
+        -> void
+    {
+        for( std::size_t i=0; i<scale * 200000; ++i ) {
+            ctx.make_cons( nullptr, nullptr );
+        }
+    }
+
+    // builds long lists and drops them
+    auto long_list( context& ctx, std::size_t const scale )
+        -> void
+    {
+        ctx.roots.push_back( nullptr );
+        for( std::size_t r=0; r<10; ++r ) {
+            ctx.roots.back() = nullptr;
+            for( std::size_t i=0; i<scale * 2000; ++i ) {
+                ctx.roots.back() = ctx.make_cons( ctx.make<blob<8>>(), ctx.roots.back() );
+            }
+        }
+        ctx.roots.pop_back();
+    }
+
+    // a root list which has many short sub lists
+    auto wide_tree( context& ctx, std::size_t const scale )
+        -> void
+    {
+        ctx.roots.push_back( nullptr );
+        for( std::size_t r=0; r<10; ++r ) {
+            ctx.roots.back() = nullptr;
+            for( std::size_t i=0; i<scale * 200; ++i ) {
+                ctx.roots.push_back( nullptr );
+                for( std::size_t j=0; j<8; ++j ) {
+                    ctx.roots.back() = ctx.make_cons( nullptr, ctx.roots.back() );
+                }
+                auto const child = ctx.roots.back();
+                ctx.roots.pop_back();
+
+                ctx.roots.back() = ctx.make_cons( child, ctx.roots.back() );
+            }
+        }
+        ctx.roots.pop_back();
+    }
+
+    // objects of various sizes, a part of them survives for a while
+    auto mixed_sizes( context& ctx, std::size_t const scale )
+        -> void
+    {
+        std::size_t const window = 64;
+        ctx.roots.resize( window, nullptr );
+
+        for( std::size_t i=0; i<scale * 40000; ++i ) {
+            node* n = nullptr;
+            switch( i % 5 ) {
+            case 0: n = ctx.make<blob<8>>(); break;
+            case 1: n = ctx.make<blob<40>>(); break;
+            case 2: n = ctx.make<blob<112>>(); break;
+            case 3: n = ctx.make<blob<256>>(); break;
+            case 4: n = ctx.make<blob<1024>>(); break;
+            }
+            ctx.roots[i % window] = n;
+        }
+        ctx.roots.clear();
+    }
+
+    // large live set and small garbage
+    auto mostly_live( context& ctx, std::size_t const scale )
+        -> void
+    {
+        ctx.roots.push_back( nullptr );
+        for( std::size_t i=0; i<scale * 2000; ++i ) {
+            ctx.roots.back() = ctx.make_cons( nullptr, ctx.roots.back() );
+        }
+
+        for( std::size_t i=0; i<scale * 20000; ++i ) {
+            ctx.make_cons( nullptr, nullptr );
+        }
+        ctx.roots.pop_back();
+    }
+
+
+    //
+    struct workload
+    {
+        char const* name;
+        void (*f)( context&, std::size_t const );
+    };
+
+    workload const workloads[] = {
+        { "churn", churn },
+        { "long_list", long_list },
+        { "wide_tree", wide_tree },
+        { "mixed_sizes", mixed_sizes },
+        { "mostly_live", mostly_live },
+    };
+
+
+    auto percentile( std::vector<std::chrono::nanoseconds> const& sorted, double const p )
+        -> long long
+    {
+        if ( sorted.empty() ) return 0;
+
+        auto const i = static_cast<std::size_t>( p * ( sorted.size() - 1 ) + 0.5 );
+        return static_cast<long long>( sorted[i].count() );
+    }
+
+    auto peak_rss_kb()
+        -> long
+    {
+        struct rusage usage;
+        ::getrusage( RUSAGE_SELF, &usage );
+
+        return usage.ru_maxrss;
+    }
+
+    auto run( void volatile const* const stack_base, workload const& w, std::size_t const scale )
+        -> void
+    {
+        context ctx( stack_base );
+
+        auto const begin_time = clock_type::now();
+        w.f( ctx, scale );
+        auto const elapsed = std::chrono::duration_cast<std::chrono::duration<double>>( clock_type::now() - begin_time );
+
+        auto pauses = ctx.pauses;
+        std::sort( pauses.begin(), pauses.end() );
+
+        std::cout << "{"
+                  << "\"workload\":\"" << w.name << "\","
+                  << "\"scale\":" << scale << ","
+                  << "\"allocations\":" << ctx.allocated_num << ","
+                  << "\"seconds\":" << elapsed.count() << ","
+                  << "\"allocations_per_second\":" << ( ctx.allocated_num / elapsed.count() ) << ","
+                  << "\"collections\":" << pauses.size() << ","
+                  << "\"pause_ns_p50\":" << percentile( pauses, 0.50 ) << ","
+                  << "\"pause_ns_p90\":" << percentile( pauses, 0.90 ) << ","
+                  << "\"pause_ns_p99\":" << percentile( pauses, 0.99 ) << ","
+                  << "\"pause_ns_max\":" << ( pauses.empty() ? 0 : pauses.back().count() ) << ","
+                  << "\"heap_bytes\":" << ctx.gc->heap_size() << ","
+                  << "\"peak_rss_kb\":" << peak_rss_kb()
+                  << "}" << std::endl;
+    }
+
+    // run in a child process to measure peak RSS of each workload separately
+    auto run_isolated( workload const& w, std::size_t const scale )
+        -> bool
+    {
+        std::cout.flush();
+
+        auto const pid = ::fork();
+        if ( pid < 0 ) return false;
+
+        if ( pid == 0 ) {
+            alignas( void* ) int volatile _dummy_stack_start_object;
+            run( &_dummy_stack_start_object, w, scale );
+
+            std::cout.flush();
+            std::_Exit( 0 );
+        }
+
+        int status = 0;
+        ::waitpid( pid, &status, 0 );
+
+        return WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+    }
+
+} // namespace
+
+
+int main( int argc, char* argv[] )
+{
+    std::size_t scale = 1;
+    if ( argc > 1 ) {
+        scale = std::max( 1, std::atoi( argv[1] ) );
+    }
+
+    std::vector<std::string> const names( argv + std::min( argc, 2 ), argv + argc );
+
+    bool succeeded = true;
+    for( auto&& w : workloads ) {
+        if ( !names.empty() && std::find( names.cbegin(), names.cend(), w.name ) == names.cend() ) {
+            continue;
+        }
+
+        if ( !run_isolated( w, scale ) ) {
+            std::cerr << "failed: " << w.name << std::endl;
+            succeeded = false;
+        }
+    }
+
+    return succeeded ? 0 : 1;
+}
@@ -50,14 +50,17 @@ auto parse_one_expression( Parser& p, It& rng_it, error_code& ec )
 //
 auto eval_source_code(
     int const volatile* const volatile stack_base,
-    std::string const& source
+    std::string const& source,
+    bool const is_hash_consing
     )
     -> void
 {
     using namespace yakkai;
     using itearator_t = ranged_iterator<std::string::const_iterator>;
 
-    auto rng_it = itearator_t( source.cbegin(), source.cend() );
+    // string literals are slices of this buffer
+    auto&& buffer = std::make_shared<std::string const>( source );
+    auto rng_it = itearator_t( buffer->cbegin(), buffer->cend() );
 
     error_code ec;
 
@@ -66,7 +69,11 @@ auto eval_source_code(
 
     //
     syntax::s_exp_parser<itearator_t, memory::gc> p( gc );
+    p.set_source( buffer );
     interpreter::machine<memory::gc> m( gc );
+    if ( is_hash_consing ) {
+        p.set_hash_consing( m.hashcons() );
+    }
 
     //
     for (;;) {
@@ -117,16 +124,17 @@ int repl(
     interpreter::machine<memory::gc> m( gc );
 
     // REPL loop
-    std::string input;
-
     for(;;) {
         // Read
         std::cout << "in > ";
 
-        std::getline( std::cin, input );
+        // each line is kept alive by string literals which refer to it
+        auto&& input = std::make_shared<std::string>();
+        std::getline( std::cin, *input );
+        p.set_source( input );
 
         //
-        auto rng_it = itearator_t( input.cbegin(), input.cend() );
+        auto rng_it = itearator_t( input->cbegin(), input->cend() );
         while( rng_it.it() != rng_it.end() ) {
             error_code error;
             auto s = parse_one_expression( p, rng_it, error );
@@ -208,6 +216,113 @@ int main()
 (deffun list (&rest objects) objects)
 (list (quote a) (quote b) 123)
 (quote (1 . 2))
+(add 4611686018427387903 1)
+(multiply 4611686018427387903 4611686018427387903 99)
+(add 123456789012345678901234567890 (multiply -1 123456789012345678901234567889))
+(add 1/3 1/6)
+(divide 10 4)
+(subtract 1/2 0.25)
+(multiply (complex 1 2) (complex 3 -1) 2)
+(divide 6 3)
+(subtract 5)
+#(1 2/3 (add 1 3))
+(vref #(1 2 3) 2)
+(vlength (make-vector 5))
+(deffun swap-first (v) (progn (vset v 0 (vref v 1)) v))
+(swap-first (make-vector 2 7))
+(array-sum (make-int64-array 1000000 3))
+(array-dot (make-double-array 5 1.5) (make-double-array 5 2))
+(deffun ramp (a) (progn (array-set a 1 -4) (array-set a 6 9) a))
+(array-add (ramp (make-int64-array 7 1)) (make-int64-array 7 10))
+(array-scale (ramp (make-double-array 7)) 1/2)
+(array-min (ramp (make-int64-array 7 1)))
+(array-max (ramp (make-double-array 9 0.5)))
+(deffun table (h) (progn (puthash &x 1 h) (puthash 123456789012345678901234567890 2 h) (puthash &x 3 h) (puthash 7 4 h) h))
+(table (make-hash-table))
+(gethash 123456789012345678901234567890 (table (make-hash-table)))
+(gethash &y (table (make-hash-table)) 42)
+(deffun shrink (h) (progn (remhash 7 h) (remhash &z h) h))
+(hash-table-count (shrink (table (make-hash-table))))
+(deffun fill (h n) (if (less n 0) h (progn (puthash n n h) (fill h (subtract n 1)))))
+(deffun churn (h) (progn (remhash 10 h) (puthash 49 49 h) (puthash 3 -3 h) h))
+(gethash 10 (churn (fill (make-hash-table) 48)) &gone)
+(hash-table-count (churn (fill (make-hash-table) 48)))
+(gethash 3 (churn (fill (make-hash-table) 48)))
+"hello, world"
+(substring "hello, world" 7)
+(concat (substring "hello, world" 0 5) " \"yakkai\"" "\tend")
+(string-length (concat "ab" "" "cde"))
+(deffun lookup (h) (progn (puthash "key" 1 h) (gethash (substring "a key" 2) h)))
+(lookup (make-hash-table))
+(eq (hashcons (quote (1 (2.5 "x") 3))) (hashcons (quote (1 (2.5 "x") 3))))
+(eq (quote (1 2)) (quote (1 2)))
+(deffun splice (l) (progn (setcdr (cdr l) (list 9 8)) (setcar (cdr l) 7) l))
+(splice (quote 1 2 3 4))
+(cdr (cdr (splice (quote 1 2 3))))
+(pmap-assoc (pmap "a" 1 &b 2) "a" 10 3 30)
+(pmap-get (pmap-dissoc (pmap 1 2 3 4) 1) 3)
+(pmap-get (pmap-dissoc (pmap 1 2 3 4) 1) 1 &missing)
+(pmap-count (pmap-assoc (pmap 1 2) 1 5))
+(deffun bytes (v) (progn (u32-set v 1 4294967295) (u8-set v 0 7) v))
+(bytes (make-bytevector 6 1))
+(u32-ref (bytes (make-bytevector 6)) 2)
+(u8-ref (map-file "/bin/sh") 1)
+(map-file "/nonexistent")
+(deffun fib (n) (if (less n 2) n (add (fib (subtract n 1)) (fib (subtract n 2)))))
+(fib 20)
+(deffun tak (x y z) (if (less y x) (tak (tak (subtract x 1) y z) (tak (subtract y 1) z x) (tak (subtract z 1) x y)) z))
+(tak 12 8 4)
+(greater 3 5/2 2.0)
+(deffun adder (n) (lambda (x) (add x n)))
+(deffun twice (f) (lambda (x) (f (f x))))
+((twice (twice (adder 2))) 1)
+(deffun outer (x) (deffun inner (y) (add x y)) (inner 1))
+(outer 5)
+(deffun fact-of (n) (deffun f (k) (if (less k 2) 1 (multiply k (f (subtract k 1))))) (f n))
+(fact-of 10)
+(deffun forward (x) (deffun a (y) (b y)) (deffun b (z) (add z 42)) (a x))
+(forward 1)
+(deffun parity (n) (deffun ev (k) (if (less k 1) 1 (od (subtract k 1)))) (deffun od (k) (if (less k 1) 0 (ev (subtract k 1)))) (ev n))
+(parity 1001)
+(deffun hypot2 (x y) ((lambda (xx yy) (add xx yy)) (multiply x x) (multiply y y)))
+(hypot2 3 4)
+(deffun count-down (n acc) (if (less n 1) acc (count-down (subtract n 1) (add acc 1))))
+(count-down 1000000 0)
+(deffun grow (n acc) (if (less n 1) acc (grow (subtract n 1) (add acc 4611686018427387000))))
+(grow 2000 0)
+(deffun boxed-double (n) (vref (make-vector 1 ((lambda (a b) (add a b)) n n)) 0))
+(boxed-double 3)
+(boxed-double 10)
+(deffun answer () 1)
+(deffun ask () (answer))
+(ask)
+(deffun answer () 2)
+(ask)
+(defmacro flip (f a b) (list f b a))
+(flip subtract 1 10)
+(deffun flip-loop (n acc) (if (less n 1) acc (flip-loop (flip subtract 1 n) (flip add 1 acc))))
+(flip-loop 100000 0)
+(defmacro flip (f a b) (list f a b))
+(flip subtract 1 10)
+(flip-loop 3 0)
+(deffun early (a) (swap subtract a 1))
+(defmacro swap (f a b) (list f b a))
+(early 3)
+(deffun later (x) (add x 1))
+(deffun call-later () (later 1))
+(call-later)
+(defmacro later (a) (list (car (quote subtract)) a 10))
+(call-later)
+(add 1 2 3 4)
+(if 1 72)
+(if () 1 2)
+(progn 1 (progn 2 (quote 3)) 4)
+(deffun seven () (progn 0 (add 1 (multiply 2 3))))
+(seven)
+(deffun lt () (if (less 1 2 3) 10 20))
+(lt)
+(deffun multiply (&rest xs) 0)
+(seven)
 ()
 1
 2
@@ -219,10 +334,20 @@ int main()
 )::";
 /* #10 r 10
 # 20 R20
-3/10
 #10r10/3
 */
     std::cout << test_case << std::endl;
-    exec_with_stack_base( eval_source_code, test_case );
+    exec_with_stack_base( eval_source_code, test_case, false );
+
+    // the same constants are shared when the reader interns them
+    std::string const hash_consing_case = R"::(
+(eq (quote (1 2)) (quote (1 2)))
+(eq 1/3 1/3)
+(deffun consts () (quote (1 (2.5 "x"))))
+(eq (consts) (quote (1 (2.5 "x"))))
+(eq (quote (1 2)) (quote (1 3)))
+)::";
+    std::cout << hash_consing_case << std::endl;
+    exec_with_stack_base( eval_source_code, hash_consing_case, true );
 #endif
 }
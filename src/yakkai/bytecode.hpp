@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "node.hpp"
+
+
+namespace yakkai
+{
+    namespace interpreter
+    {
+        class native_code;
+    }
+
+    // instructions of the stack vm. operands are a and b of instruction
+    enum class opcode : std::uint8_t
+    {
+        e_constant,         // push constants[a]
+        e_local,            // push slot a of the frame
+        e_store_local,      // pop the top into slot a of the frame
+        e_free,             // push value a copied into the running closure
+        e_set_free,         // pop the top into value b of the closure in slot a, if the slot holds one
+        e_global,           // push the value in global cell a
+        e_pop,              // drop the top
+        e_jump,             // go to a
+        e_jump_if_nil,      // pop the top, go to a if it is nil
+        e_jump_if_rebound,  // go to a if the cell of guards[b] does not hold the value of it any more
+        e_jump_if_macro,    // go to a if the cell of call_sites[b] holds a macro
+        e_closure,          // replace b values on the top by a closure of the function constants[a]
+        e_call,             // call the callee placed under a arguments
+        e_tail_call,        // same as e_call, but a compiled callee takes over the frame
+        e_call_global,      // call the value of call_sites[a] with b arguments on the top
+        e_tail_call_global, // same as e_call_global in tail position
+        e_return,           // return the top to the caller
+        e_define_global,    // bind the top to symbol constants[a], the top is kept
+        e_eval_form,        // evaluate constants[a] by the tree-walker with slots named by slot_names[b]
+
+        // builtins of b arguments. they are guarded by guards[a], whose cell must hold the native yet
+        e_add,
+        e_subtract,
+        e_multiply,
+        e_less,
+        e_greater
+    };
+
+    constexpr std::size_t opcode_num = static_cast<std::size_t>( opcode::e_greater ) + 1;
+
+
+    //
+    struct instruction
+    {
+        opcode op;
+        std::uint32_t a;
+        std::uint32_t b;
+    };
+
+
+    // global cell which must still hold the native, otherwise the builtin is called as usual.
+    // macros expanded in place are guarded in the same way
+    struct builtin_guard
+    {
+        node* const* cell;
+        node* native;
+    };
+
+
+    // inline cache of a call to a global function. the value of the cell is reused while
+    // no global was defined since it was read
+    struct call_site
+    {
+        node* const* cell;
+        mutable std::size_t version;        // 0 never matches, the global scope is defined at startup
+        mutable node* callee;
+    };
+
+
+    // compiled body of a function. made by interpreter::compiler, executed by interpreter::vm.
+    // variables are resolved when the function is compiled: parameters to slots of the frame,
+    // variables of enclosing functions to values copied into the closure and others to global cells
+    struct code_object
+    {
+        std::vector<instruction> instructions;
+        std::vector<node*> constants;
+        std::vector<node* const*> cells;    // cells live as long as the global scope
+        std::vector<builtin_guard> guards;
+        std::vector<call_site> call_sites;
+
+        std::size_t param_num = 0;          // required parameters, they take slots from 0
+        bool has_rest = false;              // the next slot takes rest of arguments as a list
+        std::size_t frame_size = 0;         // slots of the frame, including ones of lambdas inlined in the body
+        std::size_t max_stack = 0;          // depth of operands on the frame
+
+        std::vector<std::vector<symbol const*>> slot_names;    // slots visible from each e_eval_form
+        std::vector<symbol const*> free_names;  // taken from the enclosing function in this order
+
+        node* source = nullptr;             // ( params body... )
+
+        std::size_t call_count = 0;
+        std::shared_ptr<interpreter::native_code> native;  // translated after it was called many times
+    };
+
+
+    // function made by the compiler. it is printed as its source.
+    // code and values are released by the destructor when page::sweep collects the node
+    struct function_value : public node
+    {
+        explicit function_value( std::shared_ptr<code_object> const& c )
+            : node( node_type::e_function, node_attribute::e_callable )
+            , code( c )
+        {}
+
+        std::shared_ptr<code_object> code;
+        std::vector<node*> free_values;     // bindings never change, so closures hold copies of them
+    };
+
+
+    // expander of a macro. it takes forms of arguments and returns the form to be evaluated instead
+    struct macro_value : public node
+    {
+        explicit macro_value( node* const e )
+            : node( node_type::e_macro )
+            , expander( e )
+        {}
+
+        node* const expander;
+    };
+
+} // namespace yakkai
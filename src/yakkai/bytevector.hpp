@@ -0,0 +1,169 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cassert>
+
+#if defined(__unix__) || defined(__APPLE__)
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# define YAKKAI_BYTEVECTOR_USE_MMAP 1
+#endif
+
+#include "node.hpp"
+
+
+namespace yakkai
+{
+    // bytes live outside of the gc heap. gc never scans them, and they are released
+    // by the destructor when page::sweep collects the node
+    struct bytevector_value : public node
+    {
+        enum class storage_kind : std::uint8_t
+        {
+            e_malloc,
+            e_mapped_file
+        };
+
+    public:
+        bytevector_value( std::size_t const size, unsigned char const fill )
+            : node( node_type::e_bytevector )
+            , data_( static_cast<unsigned char*>( std::malloc( size == 0 ? 1 : size ) ) )
+            , size_( size )
+            , kind_( storage_kind::e_malloc )
+        {
+            assert( data_ != nullptr );
+            std::memset( data_, fill, size );
+        }
+
+        bytevector_value( bytevector_value const& ) = delete;
+
+        ~bytevector_value()
+        {
+            release();
+        }
+
+    public:
+        // maps the file read only. returns false if the file cannot be mapped
+        auto map_file( std::string const& path )
+            -> bool
+        {
+            release();
+
+#if defined(YAKKAI_BYTEVECTOR_USE_MMAP)
+            int const fd = ::open( path.c_str(), O_RDONLY );
+            if ( fd < 0 ) return false;
+
+            struct stat st;
+            if ( ::fstat( fd, &st ) != 0 ) {
+                ::close( fd );
+                return false;
+            }
+
+            auto const size = static_cast<std::size_t>( st.st_size );
+            void* p = nullptr;
+            if ( size > 0 ) {
+                p = ::mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            }
+            ::close( fd );  // mapping is kept after closing
+
+            if ( p == MAP_FAILED ) return false;
+
+            data_ = static_cast<unsigned char*>( p );
+            size_ = size;
+            kind_ = storage_kind::e_mapped_file;
+            return true;
+#else
+            // read whole of the file instead
+            auto const fp = std::fopen( path.c_str(), "rb" );
+            if ( fp == nullptr ) return false;
+
+            std::fseek( fp, 0, SEEK_END );
+            auto const size = static_cast<std::size_t>( std::ftell( fp ) );
+            std::fseek( fp, 0, SEEK_SET );
+
+            data_ = static_cast<unsigned char*>( std::malloc( size == 0 ? 1 : size ) );
+            size_ = std::fread( data_, 1, size, fp );
+            kind_ = storage_kind::e_malloc;
+            std::fclose( fp );
+            return true;
+#endif
+        }
+
+    public:
+        inline auto data() const
+            -> unsigned char*
+        {
+            return data_;
+        }
+
+        inline auto size() const
+            -> std::size_t
+        {
+            return size_;
+        }
+
+        inline auto is_read_only() const
+            -> bool
+        {
+            return kind_ == storage_kind::e_mapped_file;
+        }
+
+        // little endian, unaligned
+        inline auto u32_at( std::size_t const offset ) const
+            -> std::uint32_t
+        {
+            assert( offset + 4 <= size_ );
+
+            unsigned char const* const p = data_ + offset;
+            return static_cast<std::uint32_t>( p[0] )
+                | ( static_cast<std::uint32_t>( p[1] ) << 8 )
+                | ( static_cast<std::uint32_t>( p[2] ) << 16 )
+                | ( static_cast<std::uint32_t>( p[3] ) << 24 );
+        }
+
+        inline auto set_u32_at( std::size_t const offset, std::uint32_t const v )
+            -> void
+        {
+            assert( offset + 4 <= size_ && !is_read_only() );
+
+            unsigned char* const p = data_ + offset;
+            p[0] = static_cast<unsigned char>( v );
+            p[1] = static_cast<unsigned char>( v >> 8 );
+            p[2] = static_cast<unsigned char>( v >> 16 );
+            p[3] = static_cast<unsigned char>( v >> 24 );
+        }
+
+    private:
+        auto release()
+            -> void
+        {
+            switch( kind_ ) {
+            case storage_kind::e_malloc:
+                std::free( data_ );
+                break;
+
+            case storage_kind::e_mapped_file:
+#if defined(YAKKAI_BYTEVECTOR_USE_MMAP)
+                if ( size_ > 0 ) ::munmap( data_, size_ );
+#endif
+                break;
+            }
+
+            data_ = nullptr;
+            size_ = 0;
+            kind_ = storage_kind::e_malloc;
+        }
+
+    private:
+        unsigned char* data_;
+        std::size_t size_;
+        storage_kind kind_;
+    };
+
+} // namespace yakkai
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+
+#include "node.hpp"
+
+
+namespace yakkai
+{
+    //
+    inline auto mix_hash( std::uint64_t h )
+        -> std::size_t
+    {
+        // finalizer of murmur3
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+
+        return static_cast<std::size_t>( h );
+    }
+
+    inline auto hash_bigint( bigint const& v )
+        -> std::size_t
+    {
+        std::uint64_t h = v.is_negative() ? 1 : 0;
+        for( auto&& l : v.limbs() ) {
+            h = ( h ^ l ) * 0x100000001b3ULL;
+        }
+        return mix_hash( h );
+    }
+
+    // consistent with is_same_key
+    inline auto hash_key( node const* const n )
+        -> std::size_t
+    {
+        if ( is_fixnum( n ) ) {
+            return mix_hash( static_cast<std::uint64_t>( fixnum_value( n ) ) );
+        }
+
+        switch( n->type ) {
+        case node_type::e_integer:
+            return hash_bigint( static_cast<bignum_value const* const>( n )->value );
+
+        case node_type::e_string:
+        {
+            // FNV-1a
+            auto&& str = static_cast<string_value const* const>( n );
+            std::uint64_t h = 0xcbf29ce484222325ULL;
+            for( std::size_t i=0; i<str->length; ++i ) {
+                h = ( h ^ static_cast<unsigned char>( str->data()[i] ) ) * 0x100000001b3ULL;
+            }
+            return mix_hash( h );
+        }
+
+        default:
+            // identity. objects never move
+            return mix_hash( static_cast<std::uint64_t>( reinterpret_cast<std::uintptr_t>( n ) ) );
+        }
+    }
+
+    // ids, integers and contents of strings
+    inline auto is_same_key( node const* const a, node const* const b )
+        -> bool
+    {
+        if ( a == b ) return true;
+        if ( is_fixnum( a ) || is_fixnum( b ) || a->type != b->type ) return false;
+
+        switch( a->type ) {
+        case node_type::e_integer:
+            return compare(
+                static_cast<bignum_value const* const>( a )->value,
+                static_cast<bignum_value const* const>( b )->value
+                ) == 0;
+
+        case node_type::e_string:
+        {
+            auto&& l = static_cast<string_value const* const>( a );
+            auto&& r = static_cast<string_value const* const>( b );
+            return l->length == r->length && std::memcmp( l->data(), r->data(), l->length ) == 0;
+        }
+
+        default:
+            return false;
+        }
+    }
+
+
+    // open addressing with linear probing. hashes are stored in slots to skip most of key comparisons.
+    // growing moves slots from the old table a few at a time on each operation
+    // instead of rehashing everything at once.
+    struct hash_table_value : public node
+    {
+        static constexpr std::size_t initial_capacity = 8;      // must be power of 2
+        static constexpr std::size_t migration_step = 16;       // slots per operation
+
+        enum class slot_state : std::uint8_t
+        {
+            e_empty,
+            e_used,
+            e_deleted
+        };
+
+        struct slot
+        {
+            std::size_t hash;
+            node* key;
+            node* value;
+            slot_state state;
+        };
+
+        using table_type = std::vector<slot>;
+
+    public:
+        hash_table_value()
+            : node( node_type::e_hash_table )
+            , table_( initial_capacity, empty_slot() )
+            , used_num_( 0 )
+            , deleted_num_( 0 )
+            , old_used_num_( 0 )
+            , migrated_index_( 0 )
+        {}
+
+    public:
+        auto find( node const* const key )
+            -> node*
+        {
+            migrate();
+
+            auto const h = hash_key( key );
+            if ( auto const s = find_slot( table_, key, h ) ) return s->value;
+            if ( auto const s = find_slot( old_table_, key, h ) ) return s->value;
+
+            return nullptr;
+        }
+
+        auto insert( node* const key, node* const value )
+            -> void
+        {
+            migrate();
+
+            auto const h = hash_key( key );
+            if ( auto const s = find_slot( table_, key, h ) ) {
+                s->value = value;
+                return;
+            }
+
+            // the key must live in only one of tables
+            if ( auto const s = find_slot( old_table_, key, h ) ) {
+                erase_slot( *s );
+            }
+
+            // entries not migrated yet will also occupy the current table
+            if ( ( size() + deleted_num_ + 1 ) * 4 > table_.size() * 3 ) {
+                grow();
+            }
+
+            auto& s = probe_free_slot( table_, h );
+            if ( s.state == slot_state::e_deleted ) --deleted_num_;
+            s = slot{ h, key, value, slot_state::e_used };
+            ++used_num_;
+        }
+
+        auto erase( node const* const key )
+            -> bool
+        {
+            migrate();
+
+            auto const h = hash_key( key );
+            if ( auto const s = find_slot( table_, key, h ) ) {
+                erase_slot( *s );
+                --used_num_;
+                ++deleted_num_;
+                return true;
+            }
+
+            if ( auto const s = find_slot( old_table_, key, h ) ) {
+                erase_slot( *s );
+                return true;
+            }
+
+            return false;
+        }
+
+        auto size() const
+            -> std::size_t
+        {
+            return used_num_ + old_used_num_;
+        }
+
+        // visits all of live entries. used by gc and printer
+        template<typename F>
+        auto for_each( F const& f ) const
+            -> void
+        {
+            for( auto&& s : table_ ) {
+                if ( s.state == slot_state::e_used ) f( s.key, s.value );
+            }
+            for( std::size_t i=migrated_index_; i<old_table_.size(); ++i ) {
+                auto&& s = old_table_[i];
+                if ( s.state == slot_state::e_used ) f( s.key, s.value );
+            }
+        }
+
+    private:
+        static auto empty_slot()
+            -> slot
+        {
+            return slot{ 0, nullptr, nullptr, slot_state::e_empty };
+        }
+
+        static auto find_slot( table_type& t, node const* const key, std::size_t const h )
+            -> slot*
+        {
+            if ( t.empty() ) return nullptr;
+
+            auto const mask = t.size() - 1;
+            for( auto i = h & mask;; i = ( i + 1 ) & mask ) {
+                auto& s = t[i];
+                if ( s.state == slot_state::e_empty ) return nullptr;
+                if ( s.state == slot_state::e_used && s.hash == h && is_same_key( s.key, key ) ) return &s;
+            }
+        }
+
+        // table always has at least one empty slot
+        static auto probe_free_slot( table_type& t, std::size_t const h )
+            -> slot&
+        {
+            auto const mask = t.size() - 1;
+            for( auto i = h & mask;; i = ( i + 1 ) & mask ) {
+                if ( t[i].state != slot_state::e_used ) return t[i];
+            }
+        }
+
+        auto erase_slot( slot& s )
+            -> void
+        {
+            if ( &s >= old_table_.data() && &s < old_table_.data() + old_table_.size() ) {
+                --old_used_num_;
+            }
+
+            s.key = nullptr;
+            s.value = nullptr;
+            s.state = slot_state::e_deleted;
+        }
+
+        auto grow()
+            -> void
+        {
+            // finish the previous growth first. rarely happens because every operation migrates slots
+            while( !old_table_.empty() ) {
+                migrate();
+            }
+
+            auto const new_capacity = used_num_ * 4 > table_.size() ? table_.size() * 2 : table_.size();
+
+            old_table_.swap( table_ );
+            table_.assign( new_capacity, empty_slot() );
+            old_used_num_ = used_num_;
+            used_num_ = 0;
+            deleted_num_ = 0;
+            migrated_index_ = 0;
+        }
+
+        auto migrate()
+            -> void
+        {
+            if ( old_table_.empty() ) return;
+
+            auto const end = std::min( migrated_index_ + migration_step, old_table_.size() );
+            for( ; migrated_index_<end; ++migrated_index_ ) {
+                auto& s = old_table_[migrated_index_];
+                if ( s.state != slot_state::e_used ) continue;
+
+                auto& to = probe_free_slot( table_, s.hash );
+                if ( to.state == slot_state::e_deleted ) --deleted_num_;
+                to = s;
+                ++used_num_;
+
+                // leave a tombstone so that lookups neither find the stale copy nor break probe chains
+                erase_slot( s );
+            }
+
+            if ( migrated_index_ == old_table_.size() ) {
+                table_type().swap( old_table_ );
+                migrated_index_ = 0;
+            }
+        }
+
+    private:
+        table_type table_;
+        std::size_t used_num_, deleted_num_;
+
+        table_type old_table_;
+        std::size_t old_used_num_;
+        std::size_t migrated_index_;
+    };
+
+} // namespace yakkai
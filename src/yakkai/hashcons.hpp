@@ -0,0 +1,202 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <functional>
+#include <cstring>
+#include <cassert>
+
+#include "node.hpp"
+#include "hash_table.hpp"
+#include "static_context.hpp"
+
+
+namespace yakkai
+{
+    // table of canonical nodes for immutable data. structurally equal data interned by
+    // the same table are one object, so they can be compared by identity.
+    // entries are weak, nodes are dropped from the table when gc collects them
+    template<typename GC>
+    class hashcons_table
+    {
+        struct atom_hash
+        {
+            auto operator()( node const* const n ) const
+                -> std::size_t
+            {
+                switch( n->type ) {
+                case node_type::e_ratio:
+                {
+                    auto&& r = static_cast<ratio_value const* const>( n );
+                    return hash_bigint( r->numerator ) ^ ( hash_bigint( r->denominator ) * 31 );
+                }
+
+                case node_type::e_float:
+                    return mix_hash( bits_of( static_cast<float_value const* const>( n )->value ) );
+
+                case node_type::e_complex:
+                {
+                    auto&& c = static_cast<complex_value const* const>( n );
+                    return mix_hash( bits_of( c->real ) ^ ( bits_of( c->imag ) * 31 ) );
+                }
+
+                default:
+                    return hash_key( n );
+                }
+            }
+        };
+
+        struct atom_equal
+        {
+            auto operator()( node const* const a, node const* const b ) const
+                -> bool
+            {
+                if ( a->type != b->type ) return false;
+
+                switch( a->type ) {
+                case node_type::e_ratio:
+                {
+                    auto&& l = static_cast<ratio_value const* const>( a );
+                    auto&& r = static_cast<ratio_value const* const>( b );
+                    return compare( l->numerator, r->numerator ) == 0 && compare( l->denominator, r->denominator ) == 0;
+                }
+
+                case node_type::e_float:
+                    return bits_of( static_cast<float_value const* const>( a )->value )
+                        == bits_of( static_cast<float_value const* const>( b )->value );
+
+                case node_type::e_complex:
+                {
+                    auto&& l = static_cast<complex_value const* const>( a );
+                    auto&& r = static_cast<complex_value const* const>( b );
+                    return bits_of( l->real ) == bits_of( r->real ) && bits_of( l->imag ) == bits_of( r->imag );
+                }
+
+                default:
+                    return is_same_key( a, b );
+                }
+            }
+        };
+
+        // children of canonical conses are canonical, so conses are keyed by their identities
+        struct cell_hash
+        {
+            auto operator()( std::pair<node const*, node const*> const& p ) const
+                -> std::size_t
+            {
+                return mix_hash( reinterpret_cast<std::uintptr_t>( p.first ) )
+                    ^ ( mix_hash( reinterpret_cast<std::uintptr_t>( p.second ) ) * 31 );
+            }
+        };
+
+    public:
+        hashcons_table( std::shared_ptr<GC> const& gc )
+            : gc_( gc )
+        {}
+
+    public:
+        // returns the canonical node which is structurally equal to n.
+        // mutable objects (vectors, arrays, hash tables...) are returned as is
+        auto intern( node* const n )
+            -> node*
+        {
+            if ( is_fixnum( n ) ) return n;
+
+            switch( n->type ) {
+            case node_type::e_list:
+                return is_nil( n ) ? static_context::nil_object : intern_list( n );
+
+            case node_type::e_integer:
+            case node_type::e_ratio:
+            case node_type::e_float:
+            case node_type::e_complex:
+            case node_type::e_string:
+                return *atoms_.insert( n ).first;
+
+            default:
+                // symbols and keywords are already unique
+                return n;
+            }
+        }
+
+        auto size() const
+            -> std::size_t
+        {
+            return atoms_.size() + cells_.size();
+        }
+
+        // drops entries which will be collected
+        auto sweep( std::function<bool (node const*)> const& is_surviving )
+            -> void
+        {
+            for( auto it = atoms_.begin(); it != atoms_.end(); ) {
+                it = is_surviving( *it ) ? std::next( it ) : atoms_.erase( it );
+            }
+
+            for( auto it = cells_.begin(); it != cells_.end(); ) {
+                it = is_surviving( it->second ) ? std::next( it ) : cells_.erase( it );
+            }
+        }
+
+    private:
+        auto intern_list( node* const list )
+            -> node*
+        {
+            // canonical elements are kept in a traced vector, because they may have been
+            // made just now and the table doesn't keep them alive
+            std::size_t size = 0;
+            node const* l = list;
+            for( ; is_list( l ) && !is_nil( l ); l = cdr( l ) ) {
+                ++size;
+            }
+            node* const tail = const_cast<node*>( l );
+
+            vector_value* volatile const elements = gc_->template make_object<vector_value>( size, static_context::nil_object );
+            {
+                std::size_t i = 0;
+                for( node const* l = list; i < size; l = cdr( l ), ++i ) {
+                    elements->elements[i] = car( l );
+                }
+            }
+            for( auto&& e : elements->elements ) {
+                e = intern( e );
+            }
+
+            // cons from the end, so that tails are shared
+            node* volatile result = is_list( tail ) ? static_context::nil_object : intern( tail );
+            for( auto it = elements->elements.crbegin(); it != elements->elements.crend(); ++it ) {
+                auto&& key = std::make_pair( static_cast<node const*>( *it ), static_cast<node const*>( result ) );
+
+                auto const found = cells_.find( key );
+                if ( found != cells_.end() ) {
+                    result = found->second;
+
+                } else {
+                    auto const c = gc_->template make_object<cons>( *it, result );
+                    cells_.emplace( key, c );
+                    result = c;
+                }
+            }
+
+            return result;
+        }
+
+    private:
+        static auto bits_of( double const d )
+            -> std::uint64_t
+        {
+            std::uint64_t b;
+            std::memcpy( &b, &d, sizeof( b ) );
+            return b;
+        }
+
+    private:
+        std::shared_ptr<GC> gc_;
+
+        std::unordered_set<node*, atom_hash, atom_equal> atoms_;
+        std::unordered_map<std::pair<node const*, node const*>, cons*, cell_hash> cells_;
+    };
+
+} // namespace yakkai
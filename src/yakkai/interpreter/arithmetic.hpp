@@ -0,0 +1,350 @@
+#pragma once
+
+#include <memory>
+#include <complex>
+#include <algorithm>
+#include <cassert>
+
+#include <iostream>
+
+#include "../node.hpp"
+#include "../util/math.hpp"
+#include "../util/bigint.hpp"
+#include "../util/printer.hpp"
+
+
+namespace yakkai
+{
+    namespace interpreter
+    {
+        enum class numeric_op
+        {
+            e_add,
+            e_subtract,
+            e_multiply,
+            e_divide
+        };
+
+        // position in the numeric tower. operands are coerced to the higher one
+        enum class numeric_rank
+        {
+            e_integer,
+            e_ratio,
+            e_float,
+            e_complex,
+            e_none
+        };
+
+
+        //
+        template<typename GC>
+        class arithmetic
+        {
+            static constexpr std::size_t op_num = 4;
+            static constexpr std::size_t rank_num = 4;
+
+            using binary_function = node* (arithmetic::*)( node* const, node* const );
+
+        public:
+            arithmetic( std::shared_ptr<GC> const& gc )
+                : gc_( gc )
+            {
+                build_table<numeric_op::e_add>();
+                build_table<numeric_op::e_subtract>();
+                build_table<numeric_op::e_multiply>();
+                build_table<numeric_op::e_divide>();
+            }
+
+        public:
+            // fixnum pairs never reach the dispatch table
+            auto add( node* const lhs, node* const rhs )
+                -> node*
+            {
+                if ( is_fixnum( lhs ) && is_fixnum( rhs ) ) {
+                    // sum of two fixnums never overflows long long
+                    return make_integer( *gc_, fixnum_value( lhs ) + fixnum_value( rhs ) );
+                }
+
+                return dispatch( numeric_op::e_add, lhs, rhs );
+            }
+
+            auto subtract( node* const lhs, node* const rhs )
+                -> node*
+            {
+                if ( is_fixnum( lhs ) && is_fixnum( rhs ) ) {
+                    return make_integer( *gc_, fixnum_value( lhs ) - fixnum_value( rhs ) );
+                }
+
+                return dispatch( numeric_op::e_subtract, lhs, rhs );
+            }
+
+            auto multiply( node* const lhs, node* const rhs )
+                -> node*
+            {
+                if ( is_fixnum( lhs ) && is_fixnum( rhs ) ) {
+                    long long r;
+                    if ( checked_multiply( fixnum_value( lhs ), fixnum_value( rhs ), r ) ) {
+                        return make_integer( *gc_, r );
+                    }
+                }
+
+                return dispatch( numeric_op::e_multiply, lhs, rhs );
+            }
+
+            auto divide( node* const lhs, node* const rhs )
+                -> node*
+            {
+                if ( is_fixnum( lhs ) && is_fixnum( rhs ) ) {
+                    auto const l = fixnum_value( lhs );
+                    auto const r = fixnum_value( rhs );
+                    if ( r != 0 && l % r == 0 ) {
+                        return make_integer( *gc_, l / r );
+                    }
+                }
+
+                return dispatch( numeric_op::e_divide, lhs, rhs );
+            }
+
+            // -1, 0 or 1 as lhs is less than, equal to or greater than rhs. complex numbers are not ordered
+            static auto compare_numbers( node const* const lhs, node const* const rhs )
+                -> int
+            {
+                if ( is_fixnum( lhs ) && is_fixnum( rhs ) ) {
+                    auto const l = fixnum_value( lhs );
+                    auto const r = fixnum_value( rhs );
+                    return ( l > r ) - ( l < r );
+                }
+
+                auto const l = rank_of( lhs );
+                auto const r = rank_of( rhs );
+                if ( l == numeric_rank::e_none || l == numeric_rank::e_complex
+                     || r == numeric_rank::e_none || r == numeric_rank::e_complex
+                    ) {
+                    assert( false && "real numbers were required" );
+                }
+
+                switch( std::max( l, r ) ) {
+                case numeric_rank::e_integer:
+                    return compare( to_bigint( lhs ), to_bigint( rhs ) );
+
+                case numeric_rank::e_ratio:
+                {
+                    // denominators are always positive
+                    bigint ln, ld, rn, rd;
+                    to_ratio_parts( lhs, ln, ld );
+                    to_ratio_parts( rhs, rn, rd );
+                    return compare( ln * rd, rn * ld );
+                }
+
+                default:
+                {
+                    auto const a = to_double( lhs );
+                    auto const b = to_double( rhs );
+                    return ( a > b ) - ( a < b );
+                }
+                }
+            }
+
+        public:
+            static auto rank_of( node const* const n )
+                -> numeric_rank
+            {
+                switch( type_of( n ) ) {
+                case node_type::e_integer:
+                    return numeric_rank::e_integer;
+                case node_type::e_ratio:
+                    return numeric_rank::e_ratio;
+                case node_type::e_float:
+                    return numeric_rank::e_float;
+                case node_type::e_complex:
+                    return numeric_rank::e_complex;
+                default:
+                    return numeric_rank::e_none;
+                }
+            }
+
+        private:
+            auto dispatch( numeric_op const op, node* const lhs, node* const rhs )
+                -> node*
+            {
+                auto const l = rank_of( lhs );
+                auto const r = rank_of( rhs );
+                if ( l == numeric_rank::e_none || r == numeric_rank::e_none ) {
+                    // type error
+                    std::cout << "!!! type error" << std::endl;
+                    print_node( l == numeric_rank::e_none ? lhs : rhs );
+                    assert( false );
+                    return nullptr;
+                }
+
+                auto const f = table_[index( op )][index( l )][index( r )];
+                return ( this->*f )( lhs, rhs );
+            }
+
+            template<numeric_op Op>
+            auto build_table()
+                -> void
+            {
+                for( std::size_t l=0; l<rank_num; ++l ) {
+                    for( std::size_t r=0; r<rank_num; ++r ) {
+                        table_[index( Op )][l][r] = [&]() -> binary_function {
+                            switch( static_cast<numeric_rank>( std::max( l, r ) ) ) {
+                            case numeric_rank::e_integer:
+                                return &arithmetic::on_integer<Op>;
+                            case numeric_rank::e_ratio:
+                                return &arithmetic::on_ratio<Op>;
+                            case numeric_rank::e_float:
+                                return &arithmetic::on_float<Op>;
+                            default:
+                                return &arithmetic::on_complex<Op>;
+                            }
+                        }();
+                    }
+                }
+            }
+
+            template<typename E>
+            static constexpr auto index( E const& e )
+                -> std::size_t
+            {
+                return static_cast<std::size_t>( e );
+            }
+
+        private:
+            template<numeric_op Op>
+            auto on_integer( node* const lhs, node* const rhs )
+                -> node*
+            {
+                auto const a = to_bigint( lhs );
+                auto const b = to_bigint( rhs );
+
+                switch( Op ) {
+                case numeric_op::e_add:
+                    return make_integer( *gc_, a + b );
+                case numeric_op::e_subtract:
+                    return make_integer( *gc_, a - b );
+                case numeric_op::e_multiply:
+                    return make_integer( *gc_, a * b );
+                case numeric_op::e_divide:
+                    return make_ratio( *gc_, a, b );
+                }
+
+                return nullptr;
+            }
+
+            template<numeric_op Op>
+            auto on_ratio( node* const lhs, node* const rhs )
+                -> node*
+            {
+                bigint ln, ld, rn, rd;
+                to_ratio_parts( lhs, ln, ld );
+                to_ratio_parts( rhs, rn, rd );
+
+                switch( Op ) {
+                case numeric_op::e_add:
+                    return make_ratio( *gc_, ln * rd + rn * ld, ld * rd );
+                case numeric_op::e_subtract:
+                    return make_ratio( *gc_, ln * rd - rn * ld, ld * rd );
+                case numeric_op::e_multiply:
+                    return make_ratio( *gc_, ln * rn, ld * rd );
+                case numeric_op::e_divide:
+                    return make_ratio( *gc_, ln * rd, ld * rn );
+                }
+
+                return nullptr;
+            }
+
+            template<numeric_op Op>
+            auto on_float( node* const lhs, node* const rhs )
+                -> node*
+            {
+                return gc_->template make_object<float_value>(
+                    compute<Op>( to_double( lhs ), to_double( rhs ) )
+                    );
+            }
+
+            template<numeric_op Op>
+            auto on_complex( node* const lhs, node* const rhs )
+                -> node*
+            {
+                auto const c = compute<Op>( to_complex( lhs ), to_complex( rhs ) );
+
+                return gc_->template make_object<complex_value>( c.real(), c.imag() );
+            }
+
+            template<numeric_op Op, typename T>
+            static auto compute( T const& a, T const& b )
+                -> T
+            {
+                switch( Op ) {
+                case numeric_op::e_add:
+                    return a + b;
+                case numeric_op::e_subtract:
+                    return a - b;
+                case numeric_op::e_multiply:
+                    return a * b;
+                case numeric_op::e_divide:
+                    return a / b;
+                }
+
+                return T();
+            }
+
+        public:
+            // coercion
+            static auto to_ratio_parts( node const* const n, bigint& numerator, bigint& denominator )
+                -> void
+            {
+                if ( is_ratio( n ) ) {
+                    auto&& r = static_cast<ratio_value const* const>( n );
+                    numerator = r->numerator;
+                    denominator = r->denominator;
+
+                } else {
+                    numerator = to_bigint( n );
+                    denominator = bigint( 1 );
+                }
+            }
+
+            static auto to_double( node const* const n )
+                -> double
+            {
+                switch( rank_of( n ) ) {
+                case numeric_rank::e_integer:
+                    return is_fixnum( n )
+                        ? static_cast<double>( fixnum_value( n ) )
+                        : static_cast<bignum_value const* const>( n )->value.to_double();
+
+                case numeric_rank::e_ratio:
+                {
+                    auto&& r = static_cast<ratio_value const* const>( n );
+                    return r->numerator.to_double() / r->denominator.to_double();
+                }
+
+                case numeric_rank::e_float:
+                    return static_cast<float_value const* const>( n )->value;
+
+                default:
+                    assert( false );
+                    return 0.0;
+                }
+            }
+
+            static auto to_complex( node const* const n )
+                -> std::complex<double>
+            {
+                if ( is_complex( n ) ) {
+                    auto&& c = static_cast<complex_value const* const>( n );
+                    return std::complex<double>( c->real, c->imag );
+                }
+
+                return std::complex<double>( to_double( n ), 0.0 );
+            }
+
+        private:
+            std::shared_ptr<GC> gc_;
+            binary_function table_[op_num][rank_num][rank_num];
+        };
+
+    } // namespace interpreter
+} // namespace yakkai
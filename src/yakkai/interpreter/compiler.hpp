@@ -0,0 +1,909 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cassert>
+
+#include "node.hpp"
+#include "../node.hpp"
+#include "../bytecode.hpp"
+#include "../static_context.hpp"
+
+
+namespace yakkai
+{
+    namespace interpreter
+    {
+        // natives which the compiler translates by itself
+        enum class builtin_form
+        {
+            e_none,
+
+            e_quote,
+            e_if,
+            e_progn,
+            e_lambda,
+            e_deffun,
+            e_defmacro,
+
+            e_add,
+            e_subtract,
+            e_multiply,
+            e_less,
+            e_greater
+        };
+
+
+        // where a variable is resolved to
+        enum class variable_kind
+        {
+            e_local,
+            e_free,
+            e_global
+        };
+
+
+        // translates forms into code of the vm. forms which the vm cannot run by itself (defmacro and
+        // malformed special forms) are left to the tree-walker, which evaluates them with slots and free
+        // values of the frame. calls of macros bound when they are compiled are replaced by the expansions,
+        // other calls of globals check for macros defined later, and forms whose values are known from
+        // literals are folded
+        template<typename GC>
+        class compiler
+        {
+            using global_cell_type = std::function<node** (symbol const*)>;
+            using expander_type = std::function<node* (macro_value const*, cons*)>;
+
+            struct local_function
+            {
+                std::size_t slot;
+                function_value const* prototype;    // null until the deffun is compiled
+            };
+
+            struct context
+            {
+                context( function_value* const f, context* const o, bool const t )
+                    : function( f )
+                    , code( *f->code )
+                    , outer( o )
+                    , is_toplevel( t )
+                    , depth( 0 )
+                {}
+
+                function_value* const function;
+                code_object& code;
+                context* const outer;       // free variables are added to it while this one is compiled
+                bool const is_toplevel;     // deffun binds globals only here
+                std::ptrdiff_t depth;
+
+                // names of slots in the current lexical scope. slots of inlined lambdas are reused
+                // by following ones after their bodies
+                std::vector<symbol const*> locals;
+
+                // slots of deffun in the body, and functions compiled for them so far
+                std::vector<local_function> functions;
+            };
+
+        public:
+            compiler( std::shared_ptr<GC> const& gc, global_cell_type const& cell, expander_type const& expand )
+                : gc_( gc )
+                , global_cell_( cell )
+                , expand_( expand )
+                , rest_keyword_( static_context::intern_keyword( "&rest" ) )
+            {}
+
+        public:
+            // forms headed by name are translated while name is bound to the native which is bound now
+            auto def_builtin( symbol const* const name, builtin_form const form )
+                -> void
+            {
+                builtins_[name] = std::make_pair( form, *global_cell_( name ) );
+            }
+
+            // function without parameters which evaluates the form
+            auto compile( node* const form )
+                -> function_value*
+            {
+                context ctx( begin_function( form ), nullptr, true );
+
+                compile_expression( form, ctx, true );
+                emit( ctx, opcode::e_return, 0, 0, -1 );
+
+                return end_function( ctx );
+            }
+
+            // ( params body... ) which refers no variables of enclosing functions
+            auto compile_lambda( node* const lambda_form )
+                -> function_value*
+            {
+                return compile_function( lambda_form, nullptr );
+            }
+
+            // functions under construction and values being folded are not reachable from anywhere
+            auto mark( std::function<void (node*)> const& marker ) const
+                -> void
+            {
+                for( auto&& f : pending_ ) {
+                    marker( f );
+                }
+                for( auto&& v : folding_ ) {
+                    marker( v );
+                }
+            }
+
+        private:
+            // ( params body... )
+            auto compile_function( node* const lambda_form, context* const outer )
+                -> function_value*
+            {
+                context ctx( begin_function( lambda_form ), outer, false );
+
+                bind_parameters( car( lambda_form ), ctx );
+                reserve_local_functions( cdr( lambda_form ), ctx );
+                compile_sequence( cdr( lambda_form ), ctx, true );
+                emit( ctx, opcode::e_return, 0, 0, -1 );
+
+                return end_function( ctx );
+            }
+
+            auto begin_function( node* const source )
+                -> function_value*
+            {
+                auto const f = gc_->template make_object<function_value>( std::make_shared<code_object>() );
+                f->code->source = source;
+                pending_.push_back( f );
+
+                return f;
+            }
+
+            auto end_function( context& ctx )
+                -> function_value*
+            {
+                ctx.code.frame_size = std::max( ctx.code.frame_size, ctx.locals.size() );
+
+                // the caller stores the function before the next allocation
+                assert( pending_.back() == ctx.function );
+                pending_.pop_back();
+
+                return ctx.function;
+            }
+
+            auto bind_parameters( node const* const params, context& ctx ) const
+                -> void
+            {
+                for( node const* p = params; !is_nil( p ); p = cdr( p ) ) {
+                    if ( car( p ) == rest_keyword_ ) {
+                        ctx.locals.push_back( static_cast<symbol const*>( car( cdr( p ) ) ) );
+                        ctx.code.has_rest = true;
+                        break;
+                    }
+
+                    ctx.locals.push_back( static_cast<symbol const*>( car( p ) ) );
+                    ++ctx.code.param_num;
+                }
+            }
+
+        private:
+            // calls in tail position replace the frame instead of growing the stack
+            auto compile_expression( node* const n, context& ctx, bool const is_tail = false )
+                -> void
+            {
+                switch( type_of( n ) ) {
+                case node_type::e_symbol:
+                    compile_variable( static_cast<symbol const*>( n ), ctx );
+                    return;
+
+                case node_type::e_list:
+                    if ( !is_nil( n ) ) {
+                        compile_form( static_cast<cons*>( n ), ctx, is_tail );
+                        return;
+                    }
+                    break;
+
+                default:
+                    break;
+                }
+
+                // self evaluating
+                emit( ctx, opcode::e_constant, add_constant( ctx, n ), 0, 1 );
+            }
+
+            auto compile_form( cons* const form, context& ctx, bool const is_tail )
+                -> void
+            {
+                auto const head = car( form );
+                auto const args = cdr( form );
+                if ( !is_list( args ) ) {
+                    leave_to_tree_walker( form, ctx );
+                    return;
+                }
+
+                switch( builtin_of( head, ctx ) ) {
+                case builtin_form::e_quote:
+                    if ( is_nil( args ) ) break;
+
+                    // quote returns all of its arguments
+                    emit( ctx, opcode::e_constant, add_constant( ctx, args ), 0, 1 );
+                    return;
+
+                case builtin_form::e_if:
+                    if ( count( args ) < 2 ) break;
+
+                    compile_if( args, ctx, is_tail );
+                    return;
+
+                case builtin_form::e_progn:
+                    compile_sequence( args, ctx, is_tail );
+                    return;
+
+                case builtin_form::e_lambda:
+                    if ( !is_compilable_lambda( args ) ) break;
+
+                    compile_closure( args, ctx );
+                    return;
+
+                case builtin_form::e_deffun:
+                    if ( is_nil( args ) || !is_symbol( car( args ) ) ) break;
+                    if ( !ctx.is_toplevel ) {
+                        compile_local_function( form, ctx );
+                        return;
+                    }
+                    if ( !is_compilable_lambda( cdr( args ) ) ) break;
+
+                    // nothing to be captured at the toplevel
+                    compile_closure( cdr( args ), ctx );
+                    emit( ctx, opcode::e_define_global, add_constant( ctx, car( args ) ), 0, 0 );
+                    return;
+
+                case builtin_form::e_defmacro:
+                    // the macro is defined when the code runs
+                    break;
+
+                case builtin_form::e_add:
+                    compile_builtin_call( opcode::e_add, form, ctx );
+                    return;
+
+                case builtin_form::e_subtract:
+                    compile_builtin_call( opcode::e_subtract, form, ctx );
+                    return;
+
+                case builtin_form::e_multiply:
+                    compile_builtin_call( opcode::e_multiply, form, ctx );
+                    return;
+
+                case builtin_form::e_less:
+                    compile_builtin_call( opcode::e_less, form, ctx );
+                    return;
+
+                case builtin_form::e_greater:
+                    compile_builtin_call( opcode::e_greater, form, ctx );
+                    return;
+
+                case builtin_form::e_none:
+                {
+                    if ( is_inlinable_lambda( head, args, ctx ) ) {
+                        compile_inlined_lambda( cdr( head ), args, ctx, is_tail );
+                        return;
+                    }
+
+                    std::size_t index;
+                    if ( is_symbol( head ) && resolve( static_cast<symbol const*>( head ), ctx, index ) == variable_kind::e_global ) {
+                        auto const value = *global_cell_( static_cast<symbol const*>( head ) );
+                        if ( value != nullptr && is_macro( value ) ) {
+                            compile_macro_call( form, static_cast<macro_value const*>( value ), ctx, is_tail );
+                            return;
+                        }
+
+                        // the callee is read from the cell after arguments were evaluated, then placed under them
+                        auto const site = ctx.code.call_sites.size();
+                        ctx.code.call_sites.push_back( call_site{ global_cell_( static_cast<symbol const*>( head ) ), 0, nullptr } );
+
+                        // the name may be (re)defined as a macro later. then arguments are not evaluated,
+                        // the tree-walker expands the form instead
+                        auto const to_expansion = emit( ctx, opcode::e_jump_if_macro, 0, site, 0 );
+
+                        auto const argc = compile_arguments( args, ctx );
+                        reserve_stack( ctx, 1 );
+
+                        auto const op = is_tail ? opcode::e_tail_call_global : opcode::e_call_global;
+                        emit( ctx, op, site, argc, 1 - static_cast<std::ptrdiff_t>( argc ) );
+                        auto const to_end = emit( ctx, opcode::e_jump, 0, 0, 0 );
+
+                        --ctx.depth;
+                        patch( ctx, to_expansion );
+                        leave_to_tree_walker( form, ctx );
+                        patch( ctx, to_end );
+                        return;
+                    }
+
+                    compile_expression( head, ctx );
+                    auto const argc = compile_arguments( args, ctx );
+                    emit( ctx, is_tail ? opcode::e_tail_call : opcode::e_call, argc, 0, -static_cast<std::ptrdiff_t>( argc ) );
+                    return;
+                }
+                }
+
+                // malformed or not supported
+                leave_to_tree_walker( form, ctx );
+            }
+
+            auto compile_if( node* const args, context& ctx, bool const is_tail )
+                -> void
+            {
+                // only the branch taken is compiled
+                bool truth;
+                if ( is_literal( car( args ), ctx, truth ) ) {
+                    auto const rest = cdr( args );
+                    if ( truth ) {
+                        compile_expression( car( rest ), ctx, is_tail );
+
+                    } else if ( is_nil( cdr( rest ) ) ) {
+                        emit( ctx, opcode::e_constant, add_constant( ctx, static_context::nil_object ), 0, 1 );
+
+                    } else {
+                        compile_expression( car( cdr( rest ) ), ctx, is_tail );
+                    }
+                    return;
+                }
+
+                compile_expression( car( args ), ctx );
+                auto const to_else = emit( ctx, opcode::e_jump_if_nil, 0, 0, -1 );
+
+                auto const rest = cdr( args );
+                compile_expression( car( rest ), ctx, is_tail );
+                auto const to_end = emit( ctx, opcode::e_jump, 0, 0, 0 );
+
+                // else starts from the depth before then
+                --ctx.depth;
+                patch( ctx, to_else );
+                if ( is_nil( cdr( rest ) ) ) {
+                    emit( ctx, opcode::e_constant, add_constant( ctx, static_context::nil_object ), 0, 1 );
+
+                } else {
+                    compile_expression( car( cdr( rest ) ), ctx, is_tail );
+                }
+                patch( ctx, to_end );
+            }
+
+            // value of the last one, nil if empty
+            auto compile_sequence( node* const body, context& ctx, bool const is_tail )
+                -> void
+            {
+                if ( is_nil( body ) ) {
+                    emit( ctx, opcode::e_constant, add_constant( ctx, static_context::nil_object ), 0, 1 );
+                    return;
+                }
+
+                for( node* b = body; !is_nil( b ); b = cdr( b ) ) {
+                    if ( is_nil( cdr( b ) ) ) {
+                        compile_expression( car( b ), ctx, is_tail );
+
+                    } else {
+                        compile_effect( car( b ), ctx );
+                    }
+                }
+            }
+
+            // the value is dropped. nested progn are flattened and literals are removed
+            auto compile_effect( node* const n, context& ctx )
+                -> void
+            {
+                bool truth;
+                if ( is_literal( n, ctx, truth ) ) return;
+
+                if ( is_list( n ) && builtin_of( car( n ), ctx ) == builtin_form::e_progn && is_list( cdr( n ) ) ) {
+                    for( node* b = cdr( n ); !is_nil( b ); b = cdr( b ) ) {
+                        compile_effect( car( b ), ctx );
+                    }
+                    return;
+                }
+
+                compile_expression( n, ctx );
+                emit( ctx, opcode::e_pop, 0, 0, -1 );
+            }
+
+            auto compile_variable( symbol const* const name, context& ctx )
+                -> void
+            {
+                std::size_t index;
+                switch( resolve( name, ctx, index ) ) {
+                case variable_kind::e_local:
+                    emit( ctx, opcode::e_local, index, 0, 1 );
+                    return;
+
+                case variable_kind::e_free:
+                    emit( ctx, opcode::e_free, index, 0, 1 );
+                    return;
+
+                case variable_kind::e_global:
+                    emit( ctx, opcode::e_global, add_cell( ctx, name ), 0, 1 );
+                    return;
+                }
+            }
+
+            // ( params body... ). returns the function which the closure is made from
+            auto compile_closure( node* const lambda_form, context& ctx )
+                -> function_value const*
+            {
+                auto const index = add_constant( ctx, compile_function( lambda_form, &ctx ) );
+
+                // free variables are known after the body was compiled
+                auto&& f = static_cast<function_value const*>( ctx.code.constants[index] );
+                auto const free_num = f->code->free_names.size();
+                if ( free_num == 0 ) {
+                    emit( ctx, opcode::e_constant, index, 0, 1 );
+                    return f;
+                }
+
+                for( auto&& name : f->code->free_names ) {
+                    compile_variable( name, ctx );
+                }
+                emit( ctx, opcode::e_closure, index, free_num, 1 - static_cast<std::ptrdiff_t>( free_num ) );
+
+                return f;
+            }
+
+            // ( deffun name params body... ) in a function body. the function is stored into the slot of
+            // the name. closures copy free values when they are made, so ones made before which refer
+            // the name (including this one itself) take the new function then
+            auto compile_local_function( cons* const form, context& ctx )
+                -> void
+            {
+                auto const name = static_cast<symbol const*>( car( cdr( form ) ) );
+                auto const lambda_form = cdr( cdr( form ) );
+                if ( !is_compilable_lambda( lambda_form ) ) {
+                    leave_to_tree_walker( form, ctx );
+                    return;
+                }
+
+                auto const i = local_function_of( name, ctx );
+                auto const slot = ctx.functions[i].slot;
+                auto const prototype = compile_closure( lambda_form, ctx );
+                ctx.functions[i].prototype = prototype;
+                emit( ctx, opcode::e_store_local, slot, 0, -1 );
+
+                for( auto&& h : ctx.functions ) {
+                    std::size_t index;
+                    if ( h.prototype == nullptr || !find_name( name, h.prototype->code->free_names, index ) ) continue;
+
+                    emit( ctx, opcode::e_local, slot, 0, 1 );
+                    emit( ctx, opcode::e_set_free, h.slot, index, -1 );
+                }
+
+                // deffun returns the function
+                emit( ctx, opcode::e_local, slot, 0, 1 );
+            }
+
+            // ( deffun name ... ) directly in the body. names take slots before the body is compiled, so that
+            // functions refer to ones defined after them
+            auto reserve_local_functions( node const* const body, context& ctx )
+                -> void
+            {
+                for( node const* b = body; is_list( b ) && !is_nil( b ); b = cdr( b ) ) {
+                    auto const form = car( b );
+                    if ( !is_list( form ) || is_nil( form ) || builtin_of( car( form ), ctx ) != builtin_form::e_deffun ) continue;
+
+                    auto const args = cdr( form );
+                    if ( !is_list( args ) || is_nil( args ) || !is_symbol( car( args ) ) ) continue;
+
+                    local_function_of( static_cast<symbol const*>( car( args ) ), ctx );
+                }
+            }
+
+            // index in functions. deffun of the same name in the scope shares the slot
+            auto local_function_of( symbol const* const name, context& ctx )
+                -> std::size_t
+            {
+                for( auto i = ctx.functions.size(); i > 0; --i ) {
+                    if ( ctx.locals[ctx.functions[i - 1].slot] == name ) return i - 1;
+                }
+
+                ctx.functions.push_back( local_function{ ctx.locals.size(), nullptr } );
+                ctx.locals.push_back( name );
+                ctx.code.frame_size = std::max( ctx.code.frame_size, ctx.locals.size() );
+
+                return ctx.functions.size() - 1;
+            }
+
+            // ( ( lambda params body... ) args... ). the lambda never escapes, so parameters take slots
+            // of this frame instead of a closure and a frame of its own
+            auto compile_inlined_lambda( node* const lambda_form, node* const args, context& ctx, bool const is_tail )
+                -> void
+            {
+                auto const argc = compile_arguments( args, ctx );
+
+                // arguments are evaluated out of the scope of parameters
+                auto const base = ctx.locals.size();
+                for( auto i = argc; i > 0; --i ) {
+                    emit( ctx, opcode::e_store_local, base + i - 1, 0, -1 );
+                }
+
+                for( node const* p = car( lambda_form ); !is_nil( p ); p = cdr( p ) ) {
+                    ctx.locals.push_back( static_cast<symbol const*>( car( p ) ) );
+                }
+                ctx.code.frame_size = std::max( ctx.code.frame_size, ctx.locals.size() );
+
+                if ( !ctx.is_toplevel ) {
+                    reserve_local_functions( cdr( lambda_form ), ctx );
+                }
+                compile_sequence( cdr( lambda_form ), ctx, is_tail );
+
+                ctx.locals.resize( base );
+                while( !ctx.functions.empty() && ctx.functions.back().slot >= base ) {
+                    ctx.functions.pop_back();
+                }
+            }
+
+            // ( name args... ). the expansion runs while name is bound to the macro, otherwise the
+            // tree-walker expands the form again
+            auto compile_macro_call( cons* const form, macro_value const* const macro, context& ctx, bool const is_tail )
+                -> void
+            {
+                auto const index = ctx.code.guards.size();
+                ctx.code.guards.push_back(
+                    builtin_guard{ global_cell_( static_cast<symbol const*>( car( form ) ) ), const_cast<macro_value*>( macro ) }
+                    );
+
+                // the expansion is cached per form, which the code refers
+                auto const expansion = expand_( macro, form );
+
+                auto const to_fallback = emit( ctx, opcode::e_jump_if_rebound, 0, index, 0 );
+                compile_expression( expansion, ctx, is_tail );
+                auto const to_end = emit( ctx, opcode::e_jump, 0, 0, 0 );
+
+                --ctx.depth;
+                patch( ctx, to_fallback );
+                leave_to_tree_walker( form, ctx );
+                patch( ctx, to_end );
+            }
+
+            // ( name args... ). the value is taken from the constant if it was folded and every builtin
+            // in the form is still bound to its native
+            auto compile_builtin_call( opcode const op, cons* const form, context& ctx )
+                -> void
+            {
+                std::vector<symbol const*> names;
+                if ( auto const v = fold( form, ctx, names ) ) {
+                    auto const index = add_constant( ctx, v );
+
+                    std::vector<std::size_t> to_fallback;
+                    for( auto&& name : names ) {
+                        ctx.code.guards.push_back( builtin_guard{ global_cell_( name ), builtins_.at( name ).second } );
+                        to_fallback.push_back( emit( ctx, opcode::e_jump_if_rebound, 0, ctx.code.guards.size() - 1, 0 ) );
+                    }
+                    emit( ctx, opcode::e_constant, index, 0, 1 );
+                    auto const to_end = emit( ctx, opcode::e_jump, 0, 0, 0 );
+
+                    --ctx.depth;
+                    for( auto&& j : to_fallback ) {
+                        patch( ctx, j );
+                    }
+                    compile_builtin_operation( op, form, ctx );
+                    patch( ctx, to_end );
+                    return;
+                }
+
+                compile_builtin_operation( op, form, ctx );
+            }
+
+            auto compile_builtin_operation( opcode const op, cons* const form, context& ctx )
+                -> void
+            {
+                auto const name = car( form );
+                auto const args = cdr( form );
+
+                auto&& native = builtins_.at( static_cast<symbol const*>( name ) ).second;
+                auto const index = ctx.code.guards.size();
+                ctx.code.guards.push_back( builtin_guard{ global_cell_( static_cast<symbol const*>( name ) ), native } );
+
+                auto const argc = compile_arguments( args, ctx );
+                emit( ctx, op, index, argc, 1 - static_cast<std::ptrdiff_t>( argc ) );
+            }
+
+            auto compile_arguments( node* const args, context& ctx )
+                -> std::size_t
+            {
+                std::size_t argc = 0;
+                for( node* a = args; !is_nil( a ); a = cdr( a ) ) {
+                    compile_expression( car( a ), ctx );
+                    ++argc;
+                }
+
+                return argc;
+            }
+
+            auto leave_to_tree_walker( node* const form, context& ctx )
+                -> void
+            {
+                capture_variables( form, ctx );
+
+                auto&& names = ctx.code.slot_names;
+                if ( names.empty() || names.back() != ctx.locals ) {
+                    names.push_back( ctx.locals );
+                }
+                emit( ctx, opcode::e_eval_form, add_constant( ctx, form ), names.size() - 1, 1 );
+            }
+
+            // conservative. symbols in the form which may refer variables of enclosing functions
+            // are copied into the closure, so that the tree-walker finds them
+            auto capture_variables( node const* const n, context& ctx )
+                -> void
+            {
+                if ( is_symbol( n ) ) {
+                    auto&& name = static_cast<symbol const*>( n );
+                    if ( is_lexical( name, ctx ) ) {
+                        std::size_t index;
+                        resolve( name, ctx, index );
+                    }
+                    return;
+                }
+                if ( !is_list( n ) ) return;
+
+                node const* l = n;
+                for( ; is_list( l ) && !is_nil( l ); l = cdr( l ) ) {
+                    capture_variables( car( l ), ctx );
+                }
+                if ( !is_list( l ) ) {
+                    capture_variables( l, ctx );
+                }
+            }
+
+        private:
+            // value of a call of pure builtins on numbers, nullptr if it is known only when it runs.
+            // names of the builtins are added to names
+            auto fold( node* const n, context const& ctx, std::vector<symbol const*>& names )
+                -> node*
+            {
+                if ( is_number( n ) ) return n;
+                if ( !is_list( n ) || is_nil( n ) || !is_list( cdr( n ) ) ) return nullptr;
+
+                auto const form = builtin_of( car( n ), ctx );
+                bool const is_comparison = form == builtin_form::e_less || form == builtin_form::e_greater;
+                if ( !is_comparison && form != builtin_form::e_add && form != builtin_form::e_subtract && form != builtin_form::e_multiply ) {
+                    return nullptr;
+                }
+
+                // arguments are kept in folding_ while others are folded
+                auto const base = folding_.size();
+                for( node* a = cdr( n ); !is_nil( a ); a = cdr( a ) ) {
+                    auto const v = fold( car( a ), ctx, names );
+                    if ( v == nullptr || ( is_comparison && is_complex( v ) ) ) {
+                        folding_.resize( base );
+                        return nullptr;
+                    }
+                    folding_.push_back( v );
+                }
+
+                auto const name = static_cast<symbol const*>( car( n ) );
+                auto&& native = static_cast<native_function const*>( builtins_.at( name ).second );
+                auto const argc = folding_.size() - base;
+                if ( argc < native->min_argc_ || argc > native->max_argc_ ) {
+                    folding_.resize( base );
+                    return nullptr;
+                }
+
+                auto const v = native->apply( folding_.data() + base, argc );
+                folding_.resize( base );
+
+                if ( std::find( names.cbegin(), names.cend(), name ) == names.cend() ) {
+                    names.push_back( name );
+                }
+
+                return v;
+            }
+
+            // self evaluating atoms and quote. truth is set to whether the value is not nil
+            auto is_literal( node const* const n, context const& ctx, bool& truth ) const
+                -> bool
+            {
+                if ( is_symbol( n ) ) return false;
+
+                if ( is_list( n ) && !is_nil( n ) ) {
+                    // quote returns its arguments
+                    if ( builtin_of( car( n ), ctx ) != builtin_form::e_quote || !is_list( cdr( n ) ) || is_nil( cdr( n ) ) ) {
+                        return false;
+                    }
+                    truth = true;
+                    return true;
+                }
+
+                truth = !is_nil( n );
+                return true;
+            }
+
+            auto builtin_of( node const* const head, context const& ctx ) const
+                -> builtin_form
+            {
+                if ( !is_symbol( head ) ) return builtin_form::e_none;
+
+                auto&& name = static_cast<symbol const*>( head );
+                if ( is_lexical( name, ctx ) ) return builtin_form::e_none;
+
+                auto&& it = builtins_.find( name );
+                if ( it == builtins_.cend() || *global_cell_( name ) != it->second.second ) {
+                    return builtin_form::e_none;
+                }
+
+                return it->second.first;
+            }
+
+            // ( params body... )
+            auto is_compilable_lambda( node const* const lambda_form ) const
+                -> bool
+            {
+                return is_list( lambda_form )
+                    && !is_nil( lambda_form )
+                    && is_valid_parameters( car( lambda_form ) );
+            }
+
+            // called in place with as many arguments as parameters
+            auto is_inlinable_lambda( node const* const head, node const* const args, context const& ctx ) const
+                -> bool
+            {
+                if ( !is_list( head ) || is_nil( head ) || builtin_of( car( head ), ctx ) != builtin_form::e_lambda ) {
+                    return false;
+                }
+
+                auto const lambda_form = cdr( head );
+                if ( !is_compilable_lambda( lambda_form ) ) return false;
+
+                std::size_t param_num = 0;
+                for( node const* p = car( lambda_form ); !is_nil( p ); p = cdr( p ) ) {
+                    if ( car( p ) == rest_keyword_ ) return false;
+                    ++param_num;
+                }
+
+                return param_num == count( args );
+            }
+
+            auto is_valid_parameters( node const* const params ) const
+                -> bool
+            {
+                if ( !is_list( params ) ) return false;
+
+                for( node const* p = params; !is_nil( p ); p = cdr( p ) ) {
+                    if ( !is_list( p ) ) return false;
+
+                    if ( car( p ) == rest_keyword_ ) {
+                        auto const rest = cdr( p );
+                        return is_list( rest ) && !is_nil( rest ) && is_symbol( car( rest ) );
+                    }
+
+                    if ( !is_symbol( car( p ) ) ) return false;
+                }
+
+                return true;
+            }
+
+            // a variable of the function or enclosing ones. a variable found at the outer function is
+            // added to free variables of every function between them
+            auto resolve( symbol const* const name, context& ctx, std::size_t& index ) const
+                -> variable_kind
+            {
+                if ( find_name( name, ctx.locals, index ) ) return variable_kind::e_local;
+                if ( find_name( name, ctx.code.free_names, index ) ) return variable_kind::e_free;
+
+                std::size_t outer_index;
+                if ( ctx.outer == nullptr || resolve( name, *ctx.outer, outer_index ) == variable_kind::e_global ) {
+                    return variable_kind::e_global;
+                }
+
+                ctx.code.free_names.push_back( name );
+                index = ctx.code.free_names.size() - 1;
+
+                return variable_kind::e_free;
+            }
+
+            // same as resolve, but nothing is captured
+            auto is_lexical( symbol const* const name, context const& ctx ) const
+                -> bool
+            {
+                std::size_t index;
+                for( auto c = &ctx; c != nullptr; c = c->outer ) {
+                    if ( find_name( name, c->locals, index ) ) return true;
+                    if ( find_name( name, c->code.free_names, index ) ) return true;
+                }
+
+                return false;
+            }
+
+            static auto find_name( symbol const* const name, std::vector<symbol const*> const& names, std::size_t& index )
+                -> bool
+            {
+                // the last one wins if names are duplicated
+                for( auto i = names.size(); i > 0; --i ) {
+                    if ( names[i - 1] == name ) {
+                        index = i - 1;
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            static auto count( node const* l )
+                -> std::size_t
+            {
+                std::size_t size = 0;
+                for( ; is_list( l ) && !is_nil( l ); l = cdr( l ) ) {
+                    ++size;
+                }
+
+                return size;
+            }
+
+        private:
+            auto emit( context& ctx, opcode const op, std::size_t const a, std::size_t const b, std::ptrdiff_t const stack_effect )
+                -> std::size_t
+            {
+                auto&& instructions = ctx.code.instructions;
+                instructions.push_back( instruction{ op, static_cast<std::uint32_t>( a ), static_cast<std::uint32_t>( b ) } );
+
+                ctx.depth += stack_effect;
+                assert( ctx.depth >= 0 );
+                if ( static_cast<std::size_t>( ctx.depth ) > ctx.code.max_stack ) {
+                    ctx.code.max_stack = ctx.depth;
+                }
+
+                return instructions.size() - 1;
+            }
+
+            // operands pushed by the next instruction before it pops
+            auto reserve_stack( context& ctx, std::size_t const n ) const
+                -> void
+            {
+                ctx.code.max_stack = std::max( ctx.code.max_stack, static_cast<std::size_t>( ctx.depth ) + n );
+            }
+
+            // the jump at index goes to the next instruction
+            auto patch( context& ctx, std::size_t const index ) const
+                -> void
+            {
+                ctx.code.instructions[index].a = static_cast<std::uint32_t>( ctx.code.instructions.size() );
+            }
+
+            auto add_constant( context& ctx, node* const n ) const
+                -> std::size_t
+            {
+                auto&& constants = ctx.code.constants;
+                for( std::size_t i=0; i<constants.size(); ++i ) {
+                    if ( constants[i] == n ) return i;
+                }
+
+                constants.push_back( n );
+                return constants.size() - 1;
+            }
+
+            auto add_cell( context& ctx, symbol const* const name ) const
+                -> std::size_t
+            {
+                auto const cell = global_cell_( name );
+
+                auto&& cells = ctx.code.cells;
+                for( std::size_t i=0; i<cells.size(); ++i ) {
+                    if ( cells[i] == cell ) return i;
+                }
+
+                cells.push_back( cell );
+                return cells.size() - 1;
+            }
+
+        private:
+            std::shared_ptr<GC> gc_;
+            global_cell_type global_cell_;
+            expander_type expand_;
+
+            keyword const* const rest_keyword_;
+            std::unordered_map<symbol const*, std::pair<builtin_form, node*>> builtins_;
+
+            std::vector<function_value*> pending_;
+            std::vector<node*> folding_;
+        };
+
+    } // namespace interpreter
+} // namespace yakkai
@@ -0,0 +1,642 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+
+#include "../node.hpp"
+#include "../bytecode.hpp"
+#include "../static_context.hpp"
+
+// hot code is translated into machine code on x86-64 linux
+#if defined(__x86_64__) && defined(__linux__) && !defined(YAKKAI_NO_JIT)
+# define YAKKAI_JIT 1
+# include <sys/mman.h>
+#endif
+
+
+namespace yakkai
+{
+    namespace interpreter
+    {
+        // calls of a function before its code is translated
+        constexpr std::size_t jit_threshold = 1000;
+
+
+        // machine code of a code_object. it works on the stack of the vm in place of the dispatch loop,
+        // and returns the index of the instruction which the vm runs next. calls, returns and failed guards
+        // are left to the vm, which enters the code again where the frame resumes.
+        // values are on the stack between instructions, so the code can be entered at any instruction
+        class native_code
+        {
+            using entry_type = std::uint32_t (*)( node** base, node*** sp, void const* at );
+
+        public:
+            native_code( void* const memory, std::size_t const size, std::vector<std::size_t> const& offsets )
+                : memory_( memory )
+                , size_( size )
+                , entry_( reinterpret_cast<entry_type>( memory ) )
+            {
+                resume_.reserve( offsets.size() );
+                for( auto&& o : offsets ) {
+                    resume_.push_back( static_cast<std::uint8_t const*>( memory ) + o );
+                }
+            }
+
+            native_code( native_code const& ) = delete;
+            native_code& operator=( native_code const& ) = delete;
+
+            ~native_code()
+            {
+#if defined(YAKKAI_JIT)
+                ::munmap( memory_, size_ );
+#endif
+            }
+
+        public:
+            // executable copy of bytes. nullptr if memory is not given
+            static auto make( std::vector<std::uint8_t> const& bytes, std::vector<std::size_t> const& offsets )
+                -> std::shared_ptr<native_code>
+            {
+#if defined(YAKKAI_JIT)
+                std::size_t const page_size = 4096;
+                auto const size = ( bytes.size() + page_size - 1 ) / page_size * page_size;
+
+                auto const memory = ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+                if ( memory == MAP_FAILED ) {
+                    return nullptr;
+                }
+
+                // never writable and executable at once
+                std::memcpy( memory, bytes.data(), bytes.size() );
+                if ( ::mprotect( memory, size, PROT_READ | PROT_EXEC ) != 0 ) {
+                    ::munmap( memory, size );
+                    return nullptr;
+                }
+
+                return std::make_shared<native_code>( memory, size, offsets );
+#else
+                return nullptr;
+#endif
+            }
+
+            // runs from instruction pc. sp is updated when the code returns
+            auto run( node** const base, node*** const sp, std::size_t const pc ) const
+                -> std::uint32_t
+            {
+                return entry_( base, sp, resume_[pc] );
+            }
+
+        private:
+            void* const memory_;
+            std::size_t const size_;
+            entry_type const entry_;
+            std::vector<void const*> resume_;
+        };
+
+
+        namespace detail
+        {
+            enum register_id : std::uint8_t
+            {
+                rax = 0, rcx = 1, rdx = 2, rbx = 3, rsp = 4, rbp = 5, rsi = 6, rdi = 7,
+                r12 = 12, r13 = 13
+            };
+
+            enum condition : std::uint8_t
+            {
+                e_overflow = 0x0,
+                e_equal = 0x4,
+                e_not_equal = 0x5,
+                e_greater_equal = 0xd,
+                e_less_equal = 0xe
+            };
+
+            enum arith_op : std::uint8_t
+            {
+                // op r/m64, r64
+                e_add = 0x01,
+                e_or = 0x09,
+                e_and = 0x21,
+                e_sub = 0x29,
+                e_cmp = 0x39,
+                e_test = 0x85,
+                e_mov = 0x89
+            };
+
+            enum arith_ext : std::uint8_t
+            {
+                // op r/m64, imm8
+                e_add_imm = 0,
+                e_or_imm = 1,
+                e_sub_imm = 5
+            };
+
+            // the few instructions which the translator needs
+            class x86_64_assembler
+            {
+            public:
+                auto bytes() const
+                    -> std::vector<std::uint8_t> const&
+                {
+                    return bytes_;
+                }
+
+                auto size() const
+                    -> std::size_t
+                {
+                    return bytes_.size();
+                }
+
+                // mov dst, [base + disp]
+                auto load( register_id const dst, register_id const base, std::int32_t const disp )
+                    -> void
+                {
+                    memory_operand( 0x8b, dst, base, disp );
+                }
+
+                // mov [base + disp], src
+                auto store( register_id const base, std::int32_t const disp, register_id const src )
+                    -> void
+                {
+                    memory_operand( 0x89, src, base, disp );
+                }
+
+                auto move( register_id const dst, register_id const src )
+                    -> void
+                {
+                    arith( e_mov, dst, src );
+                }
+
+                auto move_imm( register_id const dst, std::uint64_t const imm )
+                    -> void
+                {
+                    emit( 0x48 | ( dst >> 3 ) );
+                    emit( 0xb8 + ( dst & 7 ) );
+                    emit64( imm );
+                }
+
+                // mov r32, imm32, upper half is cleared
+                auto move_imm32( register_id const dst, std::uint32_t const imm )
+                    -> void
+                {
+                    assert( dst < 8 );
+                    emit( 0xb8 + dst );
+                    emit32( imm );
+                }
+
+                // op dst, src
+                auto arith( arith_op const op, register_id const dst, register_id const src )
+                    -> void
+                {
+                    emit( 0x48 | ( ( src >> 3 ) << 2 ) | ( dst >> 3 ) );
+                    emit( op );
+                    emit( 0xc0 | ( ( src & 7 ) << 3 ) | ( dst & 7 ) );
+                }
+
+                auto arith_imm8( arith_ext const ext, register_id const dst, std::int8_t const imm )
+                    -> void
+                {
+                    emit( 0x48 | ( dst >> 3 ) );
+                    emit( 0x83 );
+                    emit( 0xc0 | ( ext << 3 ) | ( dst & 7 ) );
+                    emit( static_cast<std::uint8_t>( imm ) );
+                }
+
+                auto arith_imm32( arith_ext const ext, register_id const dst, std::int32_t const imm )
+                    -> void
+                {
+                    emit( 0x48 | ( dst >> 3 ) );
+                    emit( 0x81 );
+                    emit( 0xc0 | ( ext << 3 ) | ( dst & 7 ) );
+                    emit32( static_cast<std::uint32_t>( imm ) );
+                }
+
+                // imul dst, src
+                auto multiply( register_id const dst, register_id const src )
+                    -> void
+                {
+                    emit( 0x48 | ( ( dst >> 3 ) << 2 ) | ( src >> 3 ) );
+                    emit( 0x0f );
+                    emit( 0xaf );
+                    emit( 0xc0 | ( ( dst & 7 ) << 3 ) | ( src & 7 ) );
+                }
+
+                // sar r, 1
+                auto shift_right( register_id const r )
+                    -> void
+                {
+                    emit( 0x48 | ( r >> 3 ) );
+                    emit( 0xd1 );
+                    emit( 0xf8 | ( r & 7 ) );
+                }
+
+                // test r8, 1
+                auto test_low_bit( register_id const r )
+                    -> void
+                {
+                    assert( r < 4 );
+                    emit( 0xf6 );
+                    emit( 0xc0 | r );
+                    emit( 0x01 );
+                }
+
+                // test r8, r8
+                auto test_byte( register_id const r )
+                    -> void
+                {
+                    assert( r < 4 );
+                    emit( 0x84 );
+                    emit( 0xc0 | ( r << 3 ) | r );
+                }
+
+                // cmovcc dst, src
+                auto move_if( condition const cc, register_id const dst, register_id const src )
+                    -> void
+                {
+                    emit( 0x48 | ( ( dst >> 3 ) << 2 ) | ( src >> 3 ) );
+                    emit( 0x0f );
+                    emit( 0x40 + cc );
+                    emit( 0xc0 | ( ( dst & 7 ) << 3 ) | ( src & 7 ) );
+                }
+
+                // returns where the displacement is, see patch
+                auto jump_if( condition const cc )
+                    -> std::size_t
+                {
+                    emit( 0x0f );
+                    emit( 0x80 + cc );
+                    emit32( 0 );
+
+                    return size() - 4;
+                }
+
+                auto jump()
+                    -> std::size_t
+                {
+                    emit( 0xe9 );
+                    emit32( 0 );
+
+                    return size() - 4;
+                }
+
+                auto jump_to( register_id const r )
+                    -> void
+                {
+                    assert( r < 8 );
+                    emit( 0xff );
+                    emit( 0xe0 | r );
+                }
+
+                auto call( register_id const r )
+                    -> void
+                {
+                    assert( r < 8 );
+                    emit( 0xff );
+                    emit( 0xd0 | r );
+                }
+
+                auto push( register_id const r )
+                    -> void
+                {
+                    if ( r >= 8 ) emit( 0x41 );
+                    emit( 0x50 + ( r & 7 ) );
+                }
+
+                auto pop( register_id const r )
+                    -> void
+                {
+                    if ( r >= 8 ) emit( 0x41 );
+                    emit( 0x58 + ( r & 7 ) );
+                }
+
+                auto ret()
+                    -> void
+                {
+                    emit( 0xc3 );
+                }
+
+                // the jump whose displacement is at goes to target
+                auto patch( std::size_t const at, std::size_t const target )
+                    -> void
+                {
+                    auto const rel = static_cast<std::int32_t>( static_cast<std::ptrdiff_t>( target ) - static_cast<std::ptrdiff_t>( at + 4 ) );
+                    std::memcpy( &bytes_[at], &rel, sizeof( rel ) );
+                }
+
+            private:
+                // [base + disp32]. rsp and r12 need sib
+                auto memory_operand( std::uint8_t const opcode, register_id const r, register_id const base, std::int32_t const disp )
+                    -> void
+                {
+                    emit( 0x48 | ( ( r >> 3 ) << 2 ) | ( base >> 3 ) );
+                    emit( opcode );
+                    emit( 0x80 | ( ( r & 7 ) << 3 ) | ( base & 7 ) );
+                    if ( ( base & 7 ) == 4 ) emit( 0x24 );
+                    emit32( static_cast<std::uint32_t>( disp ) );
+                }
+
+                auto emit( std::uint8_t const b )
+                    -> void
+                {
+                    bytes_.push_back( b );
+                }
+
+                auto emit32( std::uint32_t const v )
+                    -> void
+                {
+                    for( int i=0; i<4; ++i ) emit( static_cast<std::uint8_t>( v >> ( i * 8 ) ) );
+                }
+
+                auto emit64( std::uint64_t const v )
+                    -> void
+                {
+                    for( int i=0; i<8; ++i ) emit( static_cast<std::uint8_t>( v >> ( i * 8 ) ) );
+                }
+
+            private:
+                std::vector<std::uint8_t> bytes_;
+            };
+
+            inline auto is_nil_value( node const* const n )
+                -> bool
+            {
+                return is_nil( n );
+            }
+
+            inline auto is_macro_value( node const* const n )
+                -> bool
+            {
+                return n != nullptr && is_macro( n );
+            }
+
+            template<typename T>
+            auto address_of( T const* const p )
+                -> std::uint64_t
+            {
+                return reinterpret_cast<std::uintptr_t>( p );
+            }
+
+        } // namespace detail
+
+
+        // loads and stores of slots, jumps, guards, builtins on fixnums and tail calls of the function itself are
+        // translated. others are left to the vm as they are. builtins are guarded as same as the vm,
+        // and fixnums are checked by their tags
+        inline auto compile_to_native( code_object const& code, node* const t_symbol )
+            -> std::shared_ptr<native_code>
+        {
+#if defined(YAKKAI_JIT)
+            using namespace detail;
+
+            x86_64_assembler as;
+            auto&& instructions = code.instructions;
+
+            // base and sp are kept in rbx and r12 (callee saved), where sp is stored in r13
+            as.push( rbx );
+            as.push( r12 );
+            as.push( r13 );
+            as.move( rbx, rdi );
+            as.move( r13, rsi );
+            as.load( r12, rsi, 0 );
+            as.jump_to( rdx );
+
+            // eax holds the index of the instruction which the vm runs
+            auto const exit = as.size();
+            as.store( r13, 0, r12 );
+            as.pop( r13 );
+            as.pop( r12 );
+            as.pop( rbx );
+            as.ret();
+
+            auto const leave = [&]( std::size_t const index ) {
+                as.move_imm32( rax, static_cast<std::uint32_t>( index ) );
+                as.patch( as.jump(), exit );
+            };
+
+            auto const push_rax = [&]() {
+                as.store( r12, 0, rax );
+                as.arith_imm8( e_add_imm, r12, 8 );
+            };
+
+            std::vector<std::size_t> offsets( instructions.size() );
+            std::vector<std::pair<std::size_t, std::size_t>> jumps;     // displacement, instruction
+            std::vector<std::pair<std::size_t, std::size_t>> bails;     // displacement, instruction left to the vm
+
+            for( std::size_t i=0; i<instructions.size(); ++i ) {
+                offsets[i] = as.size();
+
+                auto&& in = instructions[i];
+                switch( in.op ) {
+                case opcode::e_constant:
+                    as.move_imm( rax, address_of( code.constants[in.a] ) );
+                    push_rax();
+                    break;
+
+                case opcode::e_local:
+                    as.load( rax, rbx, in.a * 8 );
+                    push_rax();
+                    break;
+
+                case opcode::e_store_local:
+                    as.arith_imm8( e_sub_imm, r12, 8 );
+                    as.load( rax, r12, 0 );
+                    as.store( rbx, in.a * 8, rax );
+                    break;
+
+                case opcode::e_global:
+                    // unbound cells are reported by the vm
+                    as.move_imm( rax, address_of( code.cells[in.a] ) );
+                    as.load( rax, rax, 0 );
+                    as.arith( e_test, rax, rax );
+                    bails.emplace_back( as.jump_if( e_equal ), i );
+                    push_rax();
+                    break;
+
+                case opcode::e_pop:
+                    as.arith_imm8( e_sub_imm, r12, 8 );
+                    break;
+
+                case opcode::e_jump:
+                    jumps.emplace_back( as.jump(), in.a );
+                    break;
+
+                case opcode::e_jump_if_nil:
+                {
+                    as.arith_imm8( e_sub_imm, r12, 8 );
+                    as.load( rax, r12, 0 );
+                    as.move_imm( rcx, address_of( static_context::nil_object ) );
+                    as.arith( e_cmp, rax, rcx );
+                    jumps.emplace_back( as.jump_if( e_equal ), in.a );
+
+                    // fixnums are never nil, other nodes are asked
+                    as.test_low_bit( rax );
+                    auto const to_next = as.jump_if( e_not_equal );
+                    as.move( rdi, rax );
+                    as.move_imm( rax, reinterpret_cast<std::uintptr_t>( &is_nil_value ) );
+                    as.call( rax );
+                    as.test_byte( rax );
+                    jumps.emplace_back( as.jump_if( e_not_equal ), in.a );
+                    as.patch( to_next, as.size() );
+                    break;
+                }
+
+                case opcode::e_jump_if_rebound:
+                {
+                    auto&& guard = code.guards[in.b];
+                    as.move_imm( rdx, address_of( guard.cell ) );
+                    as.load( rdx, rdx, 0 );
+                    as.move_imm( rsi, address_of( guard.native ) );
+                    as.arith( e_cmp, rdx, rsi );
+                    jumps.emplace_back( as.jump_if( e_not_equal ), in.a );
+                    break;
+                }
+
+                case opcode::e_jump_if_macro:
+                {
+                    // the value bound now is passed without asking unless it is a macro
+                    auto&& site = code.call_sites[in.b];
+                    auto const value = *site.cell;
+                    as.move_imm( rdi, address_of( site.cell ) );
+                    as.load( rdi, rdi, 0 );
+
+                    std::size_t to_next = 0;
+                    bool const is_known = !is_macro_value( value );
+                    if ( is_known ) {
+                        as.move_imm( rcx, address_of( value ) );
+                        as.arith( e_cmp, rdi, rcx );
+                        to_next = as.jump_if( e_equal );
+                    }
+
+                    as.move_imm( rax, reinterpret_cast<std::uintptr_t>( &is_macro_value ) );
+                    as.call( rax );
+                    as.test_byte( rax );
+                    jumps.emplace_back( as.jump_if( e_not_equal ), in.a );
+                    if ( is_known ) {
+                        as.patch( to_next, as.size() );
+                    }
+                    break;
+                }
+
+                case opcode::e_tail_call_global:
+                {
+                    // calls of the function itself become jumps while the name is bound to it
+                    auto const argc = in.b;
+                    if ( argc != code.param_num || code.has_rest ) {
+                        leave( i );
+                        break;
+                    }
+
+                    as.move_imm( rax, address_of( code.call_sites[in.a].cell ) );
+                    as.load( rax, rax, 0 );
+                    as.load( rcx, rbx, -8 );
+                    as.arith( e_cmp, rax, rcx );
+                    bails.emplace_back( as.jump_if( e_not_equal ), i );
+
+                    // arguments are above slots, so they are moved down from the first one
+                    for( std::size_t k=0; k<argc; ++k ) {
+                        as.load( rax, r12, -static_cast<std::int32_t>( ( argc - k ) * 8 ) );
+                        as.store( rbx, k * 8, rax );
+                    }
+                    if ( code.frame_size > argc ) {
+                        as.move_imm( rax, address_of( static_context::nil_object ) );
+                        for( auto k = argc; k < code.frame_size; ++k ) {
+                            as.store( rbx, k * 8, rax );
+                        }
+                    }
+                    as.move( r12, rbx );
+                    as.arith_imm32( e_add_imm, r12, static_cast<std::int32_t>( code.frame_size * 8 ) );
+                    jumps.emplace_back( as.jump(), 0 );
+                    break;
+                }
+
+                case opcode::e_add:
+                case opcode::e_subtract:
+                case opcode::e_multiply:
+                case opcode::e_less:
+                case opcode::e_greater:
+                {
+                    if ( in.b != 2 ) {
+                        leave( i );
+                        break;
+                    }
+
+                    // the stack is not touched until the result is stored, so the vm runs the instruction again
+                    auto&& guard = code.guards[in.a];
+                    as.move_imm( rdx, address_of( guard.cell ) );
+                    as.load( rdx, rdx, 0 );
+                    as.move_imm( rsi, address_of( guard.native ) );
+                    as.arith( e_cmp, rdx, rsi );
+                    bails.emplace_back( as.jump_if( e_not_equal ), i );
+
+                    as.load( rax, r12, -16 );
+                    as.load( rcx, r12, -8 );
+                    as.move( rdx, rax );
+                    as.arith( e_and, rdx, rcx );
+                    as.test_low_bit( rdx );
+                    bails.emplace_back( as.jump_if( e_equal ), i );
+
+                    // tagged as 2n+1. results out of fixnums overflow, then bignums are made by the vm
+                    switch( in.op ) {
+                    case opcode::e_add:
+                        as.arith_imm8( e_sub_imm, rax, 1 );
+                        as.arith( e_add, rax, rcx );
+                        bails.emplace_back( as.jump_if( e_overflow ), i );
+                        break;
+
+                    case opcode::e_subtract:
+                        as.arith( e_sub, rax, rcx );
+                        bails.emplace_back( as.jump_if( e_overflow ), i );
+                        as.arith_imm8( e_or_imm, rax, 1 );
+                        break;
+
+                    case opcode::e_multiply:
+                        as.arith_imm8( e_sub_imm, rax, 1 );
+                        as.shift_right( rcx );
+                        as.multiply( rax, rcx );
+                        bails.emplace_back( as.jump_if( e_overflow ), i );
+                        as.arith_imm8( e_or_imm, rax, 1 );
+                        break;
+
+                    default:
+                        // tags don't change the order
+                        as.arith( e_cmp, rax, rcx );
+                        as.move_imm( rax, address_of( t_symbol ) );
+                        as.move_imm( rdx, address_of( static_context::nil_object ) );
+                        as.move_if( in.op == opcode::e_less ? e_greater_equal : e_less_equal, rax, rdx );
+                        break;
+                    }
+
+                    as.store( r12, -16, rax );
+                    as.arith_imm8( e_sub_imm, r12, 8 );
+                    break;
+                }
+
+                default:
+                    // calls, returns and others
+                    leave( i );
+                    break;
+                }
+            }
+
+            for( auto&& b : bails ) {
+                as.patch( b.first, as.size() );
+                leave( b.second );
+            }
+
+            for( auto&& j : jumps ) {
+                as.patch( j.first, offsets[j.second] );
+            }
+
+            return native_code::make( as.bytes(), offsets );
+#else
+            return nullptr;
+#endif
+        }
+
+    } // namespace interpreter
+} // namespace yakkai
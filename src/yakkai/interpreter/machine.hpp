@@ -2,14 +2,27 @@
 
 #include <memory>
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <utility>
+#include <iterator>
 #include <cassert>
 
 #include <iostream>
 
 #include "node.hpp"
 #include "scope.hpp"
+#include "arithmetic.hpp"
+#include "compiler.hpp"
+#include "vm.hpp"
 #include "../node.hpp"
 #include "../static_context.hpp"
+#include "../hash_table.hpp"
+#include "../hashcons.hpp"
+#include "../pmap.hpp"
+#include "../bytevector.hpp"
+#include "../util/numeric_kernel.hpp"
 
 
 namespace yakkai
@@ -23,24 +36,103 @@ namespace yakkai
             machine( std::shared_ptr<GC> const& gc )
                 : scope_( std::make_shared<scope>() )
                 , gc_( gc )
+                , arith_( gc )
+                , rest_keyword_( static_context::intern_keyword( "&rest" ) )
+                , t_symbol_( static_context::intern_symbol( "t" ) )
+                , hashcons_( std::make_shared<hashcons_table<GC>>( gc ) )
+                , compiler_(
+                    gc,
+                    std::bind( &machine::global_cell, this, std::placeholders::_1 ),
+                    std::bind( &machine::expand_macro, this, std::placeholders::_1, std::placeholders::_2 )
+                    )
+                , vm_( gc, *this )
             {
                 using namespace std::placeholders;
 
                 gc_->cha( std::bind( &machine::mark_scoped_value, this, _1 ) );
+                gc_->on_marked( std::bind( &machine::sweep_weak_references, this, _1 ) );
 
-                //
-                def_global_native_function( "deffun", std::bind( &machine::define_function, this, _1, _2 ) );
-                def_global_native_function( "add", std::bind( &machine::add, this, _1, _2 ) );
-                def_global_native_function( "multiply", std::bind( &machine::multiply, this, _1, _2 ) );
-
-                def_global_native_function( "lambda", std::bind( &machine::make_lambda, this, _1, _2 ) );
-                def_global_native_function( "progn", std::bind( &machine::progn, this, _1, _2 ) );
+                scope_->def_symbol( t_symbol_, t_symbol_ );
 
-                def_global_native_function( "quote", std::bind( &machine::quote, this, _1, _2 ) );
-
-                def_global_native_function( "if", std::bind( &machine::if_function, this, _1, _2 ) );
-                // def_global_native_function( "car", std::bind( &machine::car, this, _1 ) );
-                // def_global_native_function( "cdr", std::bind( &machine::cdr, this, _1 ) );
+                //
+                def_global_special_form( "deffun", &machine::form_native<&machine::define_function> );
+                def_global_special_form( "defmacro", &machine::form_native<&machine::define_macro> );
+                def_global_native_function( "add", &machine::value_native<&machine::add>, 0, native_function::variadic );
+                def_global_native_function( "subtract", &machine::value_native<&machine::subtract>, 1, native_function::variadic );
+                def_global_native_function( "multiply", &machine::value_native<&machine::multiply>, 0, native_function::variadic );
+                def_global_native_function( "divide", &machine::value_native<&machine::divide>, 1, native_function::variadic );
+                def_global_native_function( "complex", &machine::value_native<&machine::make_complex>, 2, 2 );
+                def_global_native_function( "less", &machine::value_native<&machine::less>, 0, native_function::variadic );
+                def_global_native_function( "greater", &machine::value_native<&machine::greater>, 0, native_function::variadic );
+
+                def_global_native_function( "make-vector", &machine::value_native<&machine::make_vector>, 1, 2 );
+                def_global_native_function( "vref", &machine::value_native<&machine::vector_ref>, 2, 2 );
+                def_global_native_function( "vset", &machine::value_native<&machine::vector_set>, 3, 3 );
+                def_global_native_function( "vlength", &machine::value_native<&machine::vector_length>, 1, 1 );
+
+                def_global_native_function( "make-int64-array", &machine::value_native<&machine::template make_typed_array<int64_array_value>>, 1, 2 );
+                def_global_native_function( "make-double-array", &machine::value_native<&machine::template make_typed_array<double_array_value>>, 1, 2 );
+                def_global_native_function( "array-ref", &machine::value_native<&machine::array_ref>, 2, 2 );
+                def_global_native_function( "array-set", &machine::value_native<&machine::array_set>, 3, 3 );
+                def_global_native_function( "array-length", &machine::value_native<&machine::array_length>, 1, 1 );
+                def_global_native_function( "array-sum", &machine::value_native<&machine::array_sum>, 1, 1 );
+                def_global_native_function( "array-dot", &machine::value_native<&machine::array_dot>, 2, 2 );
+                def_global_native_function( "array-add", &machine::value_native<&machine::array_add>, 2, 2 );
+                def_global_native_function( "array-mul", &machine::value_native<&machine::array_mul>, 2, 2 );
+                def_global_native_function( "array-scale", &machine::value_native<&machine::array_scale>, 2, 2 );
+                def_global_native_function( "array-min", &machine::value_native<&machine::array_min>, 1, 1 );
+                def_global_native_function( "array-max", &machine::value_native<&machine::array_max>, 1, 1 );
+
+                def_global_native_function( "concat", &machine::value_native<&machine::concat>, 0, native_function::variadic );
+                def_global_native_function( "substring", &machine::value_native<&machine::substring>, 2, 3 );
+                def_global_native_function( "string-length", &machine::value_native<&machine::string_length>, 1, 1 );
+
+                def_global_native_function( "make-hash-table", &machine::value_native<&machine::make_hash_table>, 0, 0 );
+                def_global_native_function( "gethash", &machine::value_native<&machine::get_hash>, 2, 3 );
+                def_global_native_function( "puthash", &machine::value_native<&machine::put_hash>, 3, 3 );
+                def_global_native_function( "remhash", &machine::value_native<&machine::remove_hash>, 2, 2 );
+                def_global_native_function( "hash-table-count", &machine::value_native<&machine::hash_table_count>, 1, 1 );
+
+                def_global_native_function( "pmap", &machine::value_native<&machine::make_pmap>, 0, native_function::variadic );
+                def_global_native_function( "pmap-get", &machine::value_native<&machine::pmap_get>, 2, 3 );
+                def_global_native_function( "pmap-assoc", &machine::value_native<&machine::pmap_assoc_function>, 1, native_function::variadic );
+                def_global_native_function( "pmap-dissoc", &machine::value_native<&machine::pmap_dissoc_function>, 2, 2 );
+                def_global_native_function( "pmap-count", &machine::value_native<&machine::pmap_count>, 1, 1 );
+
+                def_global_native_function( "make-bytevector", &machine::value_native<&machine::make_bytevector>, 1, 2 );
+                def_global_native_function( "map-file", &machine::value_native<&machine::map_file>, 1, 1 );
+                def_global_native_function( "bytevector-length", &machine::value_native<&machine::bytevector_length>, 1, 1 );
+                def_global_native_function( "u8-ref", &machine::value_native<&machine::u8_ref>, 2, 2 );
+                def_global_native_function( "u8-set", &machine::value_native<&machine::u8_set>, 3, 3 );
+                def_global_native_function( "u32-ref", &machine::value_native<&machine::u32_ref>, 2, 2 );
+                def_global_native_function( "u32-set", &machine::value_native<&machine::u32_set>, 3, 3 );
+
+                def_global_special_form( "lambda", &machine::form_native<&machine::make_lambda> );
+                def_global_special_form( "progn", &machine::form_native<&machine::progn> );
+
+                def_global_special_form( "quote", &machine::form_native<&machine::quote> );
+                def_global_native_function( "list", &machine::value_native<&machine::list>, 0, native_function::variadic );
+                def_global_native_function( "hashcons", &machine::value_native<&machine::hashcons_function>, 1, 1 );
+                def_global_native_function( "eq", &machine::value_native<&machine::eq>, 2, 2 );
+
+                def_global_special_form( "if", &machine::form_native<&machine::if_function> );
+                def_global_native_function( "car", &machine::value_native<&machine::car_function>, 1, 1 );
+                def_global_native_function( "cdr", &machine::value_native<&machine::cdr_function>, 1, 1 );
+                def_global_native_function( "setcar", &machine::value_native<&machine::set_car_function>, 2, 2 );
+                def_global_native_function( "setcdr", &machine::value_native<&machine::set_cdr_function>, 2, 2 );
+
+                // the compiler translates these forms by itself while the names are bound to the natives above
+                compiler_.def_builtin( static_context::intern_symbol( "quote" ), builtin_form::e_quote );
+                compiler_.def_builtin( static_context::intern_symbol( "if" ), builtin_form::e_if );
+                compiler_.def_builtin( static_context::intern_symbol( "progn" ), builtin_form::e_progn );
+                compiler_.def_builtin( static_context::intern_symbol( "lambda" ), builtin_form::e_lambda );
+                compiler_.def_builtin( static_context::intern_symbol( "deffun" ), builtin_form::e_deffun );
+                compiler_.def_builtin( static_context::intern_symbol( "defmacro" ), builtin_form::e_defmacro );
+                compiler_.def_builtin( static_context::intern_symbol( "add" ), builtin_form::e_add );
+                compiler_.def_builtin( static_context::intern_symbol( "subtract" ), builtin_form::e_subtract );
+                compiler_.def_builtin( static_context::intern_symbol( "multiply" ), builtin_form::e_multiply );
+                compiler_.def_builtin( static_context::intern_symbol( "less" ), builtin_form::e_less );
+                compiler_.def_builtin( static_context::intern_symbol( "greater" ), builtin_form::e_greater );
             }
 
         private:
@@ -50,39 +142,67 @@ namespace yakkai
 
                 std::cout << "ababa" << std::endl;
                 scope_->f( marker );
+
+                vm_.mark( marker );
+                compiler_.mark( marker );
+
+                // forms are weak keys, see sweep_weak_references
+                for( auto&& e : expansions_ ) {
+                    marker( const_cast<macro_value*>( e.second.first ) );
+                    marker( e.second.second );
+                }
+            }
+
+            auto sweep_weak_references( std::function<bool (node const*)> const& is_surviving )
+                -> void
+            {
+                hashcons_->sweep( is_surviving );
+
+                for( auto it = expansions_.begin(); it != expansions_.end(); ) {
+                    it = is_surviving( it->first ) ? std::next( it ) : expansions_.erase( it );
+                }
             }
 
         public:
+            // forms are compiled and run by the vm
             auto eval( node* const n )
                 -> node*
             {
-                return as_node( eval( n, scope_ ) );
+                // reachable from the code after it was compiled
+                node* volatile const form = n;
+
+                vm_.push( compiler_.compile( form ) );
+                return vm_.call( 0 );
             }
 
         private:
             auto eval( node* const n, std::shared_ptr<scope> const& current_scope )
                 -> std::tuple<node*, std::shared_ptr<scope>>
             {
-                if ( is_nil( n ) ) {
-                    return std::forward_as_tuple( static_context::nil_object, current_scope );
+                switch( type_of( n ) ) {
+                case node_type::e_list:
+                {
+                    if ( is_nil( n ) ) {
+                        return std::forward_as_tuple( static_context::nil_object, current_scope );
+                    }
 
-                } else if ( n->type == node_type::e_list ) {
                     // list is given
                     auto c = static_cast<cons* const>( n );
 
-                    if ( is_nil( c ) ) {
-                        assert( false && "nil was given..." );
-                    }
-
                     // try to call(function/macro)
-                    auto&& head_p = eval( c->car, current_scope );
-                    if ( is_callable( as_node( head_p ) ) ) {
-                        assert( is_list( c->cdr ) );
+                    auto&& head_p = eval( car( c ), current_scope );
+                    if ( is_macro( as_node( head_p ) ) ) {
+                        node* volatile const expansion = expand_macro( static_cast<macro_value const*>( as_node( head_p ) ), c );
+
+                        return eval( expansion, current_scope );
+
+                    } else if ( is_callable( as_node( head_p ) ) ) {
+                        assert( is_list( cdr( c ) ) );
 
                         return std::forward_as_tuple(
                             call_function(
                                 static_cast<symbol const* const>( as_node( head_p ) ),
-                                static_cast<cons* const>( c->cdr ),
+                                static_cast<cons* const>( cdr( c ) ),
                                 as_scope( head_p ),
                                 current_scope
                                 ),
@@ -90,16 +210,18 @@ namespace yakkai
                             );
 
                     } else {
-                        // TODO: check that is macro given...
                         print_node( as_node( head_p ) );
                         assert( false && "reciever is not callable..." );
                     }
+                }
+                break;
 
-                } else if ( n->type == node_type::e_symbol ) {
+                case node_type::e_symbol:
+                {
                     auto&& reciever_symbol = static_cast<symbol const* const>( n );
 
                     // std::cout << "look_up: " << reciever_symbol->value << std::endl;
-                    auto&& p = current_scope->find( reciever_symbol->value );
+                    auto&& p = current_scope->find( reciever_symbol );
 
                     auto&& target_node = as_node( p );
                     if ( target_node == nullptr ) {
@@ -109,22 +231,64 @@ namespace yakkai
                     return p;
                 }
 
-                // otherwise, return
+                default:
+                    break;
+                }
+
+                // otherwise(self evaluating), return
                 return std::forward_as_tuple( n, current_scope );
             }
 
         public:
-            template<typename F>
-            auto def_global_native_function( std::string const& name, F&& f )
+            // the reader shares this table to intern literals
+            auto hashcons() const
+                -> std::shared_ptr<hashcons_table<GC>> const&
+            {
+                return hashcons_;
+            }
+
+        public:
+            auto def_global_native_function(
+                std::string const& name,
+                native_function::value_function_type const f,
+                std::size_t const min_argc,
+                std::size_t const max_argc
+                )
+                -> node*
+            {
+                return scope_->def_symbol(
+                    static_context::intern_symbol( name ),
+                    gc_->template make_object<native_function>( f, this, min_argc, max_argc ),
+                    scope_->make_inner_scope()
+                    );
+            }
+
+            auto def_global_special_form( std::string const& name, native_function::form_function_type const f )
                 -> node*
             {
                 return scope_->def_symbol(
-                    name,
-                    gc_->template make_object<native_function>( std::forward<F>( f ) ),
+                    static_context::intern_symbol( name ),
+                    gc_->template make_object<native_function>( f, this ),
                     scope_->make_inner_scope()
                     );
             }
 
+        private:
+            // members are bound at compile time, so natives are called without std::function
+            template<node* (machine::*F)( cons* const, std::shared_ptr<scope> const& )>
+            static auto form_native( void* const self, cons* const n, std::shared_ptr<scope> const& current_scope )
+                -> node*
+            {
+                return ( static_cast<machine*>( self )->*F )( n, current_scope );
+            }
+
+            template<node* (machine::*F)( node* const* const, std::size_t const )>
+            static auto value_native( void* const self, node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                return ( static_cast<machine*>( self )->*F )( args, argc );
+            }
+
         private:
             auto call_function(
                 node const* const reciever,
@@ -134,113 +298,137 @@ namespace yakkai
                 )
                 -> node*
             {
-                if ( is_native_function( reciever ) ) {
-                    auto&& ns = static_cast<native_function const* const>( reciever );
-                    assert( ns->f_ != nullptr );
-
+                auto&& native = is_native_function( reciever )
+                    ? static_cast<native_function const*>( reciever )
+                    : nullptr;
+                if ( native != nullptr && native->is_special_form() ) {
                     // call native function
-                    return (ns->f_)( args, current_scope );
+                    return native->apply_form( args, current_scope );
+                }
 
-                } else {
-                    //
-                    assert( target_scope != nullptr );
-
-                    //
-                    // eval args( rewrite list )
-                    {
-                        auto head = args;
-                        while( !is_nil( head ) ) {
-                            auto&& p = as_node( eval( head->car, current_scope ) );
-                            std::swap( head->car, p );
-
-                            assert( is_list( head->cdr ) );
-                            head = static_cast<cons* const>( head->cdr );
-                        }
-                    }
+                // arguments are evaluated onto the stack of the vm, so the source list is kept as it is.
+                // compiled functions take them there
+                if ( is_function( reciever ) ) {
+                    vm_.push( const_cast<node*>( reciever ) );
+                }
+
+                node** const arguments = vm_.top();
+                std::size_t argc = 0;
+                for( cons const* head = args; !is_nil( head ); head = static_cast<cons const*>( cdr( head ) ) ) {
+                    assert( is_list( cdr( head ) ) );
+
+                    auto const v = as_node( eval( car( head ), current_scope ) );
+                    vm_.push( v );
+                    ++argc;
+                }
+
+                if ( is_function( reciever ) ) {
+                    return vm_.call( argc );
+                }
+
+                auto const v = native != nullptr
+                    ? native->apply( arguments, argc )
+                    : apply_lambda_form( reciever, arguments, argc, target_scope );
+                vm_.drop( argc );
+
+                return v;
+            }
+
+            // ( params body... ) called with values of arguments
+            auto apply_lambda_form(
+                node const* const reciever,
+                node* const* const arguments,
+                std::size_t const argc,
+                std::shared_ptr<scope> const& target_scope
+                )
+                -> node*
+            {
+                //
+                assert( target_scope != nullptr );
 
-                    auto&& new_scope = target_scope->make_inner_scope();
+                auto&& new_scope = target_scope->make_inner_scope();
 
-                    //
-                    assert( is_list( reciever ) && !is_nil( reciever ) );
-                    auto params = static_cast<cons const* const>( reciever )->car;
-                    assert( !is_nil( params ) );
+                //
+                assert( is_list( reciever ) && !is_nil( reciever ) );
+                auto params = car( reciever );
+                assert( !is_nil( params ) );
 
-                    //
-                    auto function_body = static_cast<cons const* const>( reciever )->cdr;
+                //
+                auto function_body = cdr( reciever );
+
+                cons const* parameter_head = static_cast<cons const* const>( params );
+                std::size_t index = 0;
+
+                // map argument/parameter
+                // TODO: optional keyword
+                assert( is_list( parameter_head ) );
+                while( !is_nil( parameter_head ) ) {
+                    // parameters
+                    if ( is_symbol( car( parameter_head ) ) ) {
+                        auto&& parameter_symbol = static_cast<symbol const* const>( car( parameter_head ) );
+                        // std::cout << "parameter : " << parameter_symbol->value << std::endl;
+
+                        if ( index == argc ) {
+                            assert( false && "wrong number of arguments" );
+                        }
 
-                    cons const* parameter_head = static_cast<cons const* const>( params );
-                    cons* argument_head = args;
+                        // set argument value
+                        new_scope->def_symbol(
+                            parameter_symbol,
+                            arguments[index]
+                            );
 
-                    //bool reached_to_last_parameter = false;
+                    } else if ( is_keyword( car( parameter_head ) ) ) {
+                        // keyword
+                        auto&& k = static_cast<keyword const* const>( car( parameter_head ) );
+                        std::cout << "? -> " << k->value << std::endl;
 
-                    // map argument/parameter
-                    // TODO: check length of parameter/arguments & optional keyword
-                    assert( is_list( argument_head ) && is_list( parameter_head ) );
-                    while( !is_nil( parameter_head ) ) {
-                        // parameters
-                        if ( is_symbol( parameter_head->car ) ) {
-                            auto&& parameter_symbol = static_cast<symbol const* const>( parameter_head->car );
-                            // std::cout << "parameter : " << parameter_symbol->value << std::endl;
+                        // update && take parameter name
+                        if ( is_nil( cdr( parameter_head ) ) ) {
+                            assert( false && "parameter name was not given" );
+                        }
+                        parameter_head = static_cast<cons const* const>( cdr( parameter_head ) );
+                        if ( !is_symbol( car( parameter_head ) ) ) {
+                            assert( false && "invalid parameter name" );
+                        }
+                        auto&& parameter_symbol = static_cast<symbol const* const>( car( parameter_head ) );
 
-                            // set argument value
+                        if ( k == rest_keyword_ ) {
+                            // set rest of arguments to this name. only this makes a list of arguments
                             new_scope->def_symbol(
-                                parameter_symbol->value,
-                                argument_head->car
+                                parameter_symbol,
+                                make_list( *gc_, arguments + index, arguments + argc, static_context::nil_object )
                                 );
 
-                        } else if ( is_keyword( parameter_head->car ) ) {
-                            // keyword
-                            auto&& k = static_cast<keyword const* const>( parameter_head->car );
-                            std::cout << "? -> " << k->value << std::endl;
-
-                            // update && take parameter name
-                            if ( is_nil( parameter_head->cdr ) ) {
-                                assert( false && "parameter name was not given" );
-                            }
-                            parameter_head = static_cast<cons const* const>( parameter_head->cdr );
-                            if ( !is_symbol( parameter_head->car ) ) {
-                                assert( false && "invalid parameter name" );
-                            }
-                            auto&& parameter_symbol = static_cast<symbol const* const>( parameter_head->car );
-
-                            if ( k->value == "&rest" ) {
-                                // set rest of arguments to this name
-                                new_scope->def_symbol(
-                                    parameter_symbol->value,
-                                    argument_head
-                                    );
-
-                                // terminate
-                                argument_head = static_context::nil_object;
-
-                                // break argument matching
-                                break;
-
-                            } else {
-                                assert( false && "keyword was not supported yet" );
-                            }
+                            // terminate
+                            index = argc;
+
+                            // break argument matching
+                            break;
 
                         } else {
-                            assert( false && "" );
+                            assert( false && "keyword was not supported yet" );
                         }
 
-                        parameter_head = static_cast<cons const* const>( parameter_head->cdr );
-
-                        // argument
-                        argument_head = static_cast<cons* const>( argument_head->cdr );
+                    } else {
+                        assert( false && "" );
                     }
 
+                    parameter_head = static_cast<cons const* const>( cdr( parameter_head ) );
 
+                    // argument
+                    ++index;
+                }
 
-                    assert( is_list( function_body ) );
-                    return eval_prog_n(
-                        static_cast<cons const*>( function_body ),
-                        new_scope
-                        );
+                if ( index != argc ) {
+                    assert( false && "wrong number of arguments" );
                 }
 
-                assert( false );
-                return nullptr;
+                assert( is_list( function_body ) );
+                return eval_prog_n(
+                    static_cast<cons const*>( function_body ),
+                    new_scope
+                    );
             }
 
             auto eval_prog_n(
@@ -253,197 +441,1172 @@ namespace yakkai
 
                 cons const* head = prog;
                 while( !is_nil( head ) ) {
-                    auto&& ret = eval( head->car, target_scope );
+                    auto&& ret = eval( car( head ), target_scope );
                     last_value = as_node( ret );
 
-                    head = static_cast<cons const*>( head->cdr );
+                    head = static_cast<cons const*>( cdr( head ) );
                 }
 
                 return last_value;
             }
 
         private:
-            auto add( cons* const n, std::shared_ptr<scope> const& current_scope )
-                -> node*
+            friend class vm<GC, machine>;
+
+            auto global_version() const
+                -> std::size_t const&
+            {
+                return scope_->version();
+            }
+
+            // compiled code refers globals through the address. names which are not defined yet
+            // take unbound cells, which deffun fills later
+            auto global_cell( symbol const* const name )
+                -> node**
             {
-                node_type nt = node_type::e_integer;
-                double result = 0.0;
+                return &scope_->entry_at( name )->first;
+            }
 
-                cons const* t = static_cast<cons const* const>( n );
-                while( !is_nil( t ) ) {
-                    auto&& v = as_node( eval( t->car, current_scope ) );
+            auto define_global( symbol const* const name, node* const value )
+                -> void
+            {
+                if ( is_function( value ) ) {
+                    std::cout << "define function !> " << name->value << std::endl;
+                }
 
-                    if ( is_integer( v ) ) {
-                        auto&& typed_val = static_cast<integer_value const* const>( v );
-                        result += typed_val->value;
+                scope_->def_symbol( name, value );
+            }
 
-                    } else if ( is_float( v ) ) {
-                        // auto&& typed_val = static_cast<float_value const* const>( v );
-                        assert( false );
+            // special forms take forms of arguments. values are passed to them as symbols bound
+            // in a temporary scope
+            auto apply_from_vm( node* const callee, node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                if ( is_macro( callee ) ) {
+                    assert( false && "macro cannot be applied as a function" );
+                }
 
-                    } else {
-                        // type error
-                        std::cout << "!!! type error" << std::endl;
-                        print_node( v );
-                        assert( false );
-                    }
+                if ( !is_callable( callee ) ) {
+                    print_node( callee );
+                    assert( false && "reciever is not callable..." );
+                }
 
-                    assert( is_list( t->cdr ) );
-                    t = static_cast<cons const* const>( t->cdr );
+                if ( !is_native_function( callee ) ) {
+                    return apply_lambda_form( callee, args, argc, scope_ );
                 }
 
-                return [&]() -> node* {
-                    if ( nt == node_type::e_integer ) {
-                         return gc_->template make_object<integer_value>( result );
+                auto&& native = static_cast<native_function const*>( callee );
+                if ( !native->is_special_form() ) {
+                    return native->apply( args, argc );
+                }
 
-                    } else if ( nt == node_type::e_float ) {
-                        assert( false );
-                    }
+                auto&& arguments_scope = std::make_shared<scope>( scope_ );
 
-                    assert( false );
-                    return nullptr;
-                }();
+                node* volatile forms = static_context::nil_object;
+                for( auto i = argc; i > 0; --i ) {
+                    auto const name = argument_symbol( i - 1 );
+                    arguments_scope->def_symbol( name, args[i - 1] );
+                    forms = gc_->template make_object<cons>( const_cast<symbol*>( name ), forms );
+                }
+
+                return call_function( callee, static_cast<cons*>( forms ), scope_, arguments_scope );
             }
 
-            auto multiply( cons* const n, std::shared_ptr<scope> const& current_scope )
+            // expansions are cached per form, and made again after the macro was redefined
+            auto expand_macro( macro_value const* const macro, cons* const form )
                 -> node*
             {
-                node_type nt = node_type::e_integer;
-                double result = 1.0;
+                auto&& it = expansions_.find( form );
+                if ( it != expansions_.cend() && it->second.first == macro ) {
+                    return it->second.second;
+                }
 
-                cons const* t = static_cast<cons const* const>( n );
-                while( !is_nil( t ) ) {
-                    auto&& v = as_node( eval( t->car, current_scope ) );
+                vm_.push( macro->expander );
+                std::size_t argc = 0;
+                for( node* a = cdr( form ); !is_nil( a ); a = cdr( a ) ) {
+                    vm_.push( car( a ) );
+                    ++argc;
+                }
 
-                    if ( is_integer( v ) ) {
-                        auto&& typed_val = static_cast<integer_value const* const>( v );
-                        result *= typed_val->value;
+                auto const expansion = vm_.call( argc );
+                expansions_[form] = std::make_pair( macro, expansion );
 
-                    } else if ( is_float( v ) ) {
-                        // auto&& typed_val = static_cast<float_value const* const>( v );
-                        assert( false );
+                return expansion;
+            }
 
-                    } else {
-                        // type error
-                        std::cout << "!!! type error" << std::endl;
-                        print_node( v );
-                        assert( false );
-                    }
+            // names which the reader never makes
+            auto argument_symbol( std::size_t const i )
+                -> symbol const*
+            {
+                while( argument_symbols_.size() <= i ) {
+                    argument_symbols_.push_back(
+                        static_context::intern_symbol( " argument" + std::to_string( argument_symbols_.size() ) )
+                        );
+                }
+
+                return argument_symbols_[i];
+            }
 
-                    assert( is_list( t->cdr ) );
-                    t = static_cast<cons const* const>( t->cdr );
+            // slots and free values of the function are visible to the form as variables
+            auto eval_with_locals(
+                node* const form,
+                function_value const* const f,
+                std::vector<symbol const*> const& slot_names,
+                node* const* const slots
+                )
+                -> node*
+            {
+                auto&& code = *f->code;
+                if ( slot_names.empty() && code.free_names.empty() ) {
+                    return as_node( eval( form, scope_ ) );
                 }
 
-                return [&]() -> node* {
-                    if ( nt == node_type::e_integer ) {
-                         return gc_->template make_object<integer_value>( result );
+                auto&& locals = std::make_shared<scope>( scope_ );
+                for( std::size_t i=0; i<code.free_names.size(); ++i ) {
+                    locals->def_symbol( code.free_names[i], f->free_values[i] );
+                }
+                for( std::size_t i=0; i<slot_names.size(); ++i ) {
+                    locals->def_symbol( slot_names[i], slots[i] );
+                }
 
-                    } else if ( nt == node_type::e_float ) {
-                        assert( false );
-                    }
+                return as_node( eval( form, locals ) );
+            }
 
-                    assert( false );
-                    return nullptr;
-                }();
+        private:
+            auto add( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                return fold_numbers( args, argc, make_fixnum( 0 ), &arithmetic<GC>::add );
             }
 
-            auto quote( cons* const n, std::shared_ptr<scope> const& )
+            auto subtract( node* const* const args, std::size_t const argc )
                 -> node*
             {
-                assert( !is_nil( n ) );
+                return fold_inverse_numbers( args, argc, &arithmetic<GC>::subtract );
+            }
 
-                return n;
+            auto multiply( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                return fold_numbers( args, argc, make_fixnum( 1 ), &arithmetic<GC>::multiply );
             }
 
-            auto define_function( cons* const n, std::shared_ptr<scope> const& current_scope )
+            auto divide( node* const* const args, std::size_t const argc )
                 -> node*
             {
-                assert( !is_nil( n ) );
+                return fold_inverse_numbers( args, argc, &arithmetic<GC>::divide );
+            }
 
-                // check function name
-                cons const* const first = n;
-                if ( !is_symbol( first->car ) ) {
-                    assert( false && "function name must be symbol" );
+            // ( complex real imag )
+            auto make_complex( node* const* const args, std::size_t const )
+                -> node*
+            {
+                auto&& real = args[0];
+                auto&& imag = args[1];
+                if ( !is_number( real ) || is_complex( real ) || !is_number( imag ) || is_complex( imag ) ) {
+                    assert( false && "parts of complex must be real numbers" );
                 }
-                symbol const* const function_name_symbol = static_cast<symbol const* const>( first->car );
 
-                // check argument
-                node* const second_n = first->cdr;
-                if ( !is_list( second_n ) || is_nil( second_n ) ) {
-                    assert( false && "missing lambda argument" );
-                }
+                // coerce parts to float by adding 0.0
+                auto&& zero = gc_->template make_object<float_value>( 0.0 );
+                return gc_->template make_object<complex_value>(
+                    static_cast<float_value const* const>( arith_.add( zero, real ) )->value,
+                    static_cast<float_value const* const>( arith_.add( zero, imag ) )->value
+                    );
+            }
 
-                node* const lambda_form
-                    = make_lambda( static_cast<cons* const>( second_n ), current_scope );
+            // ( less a b c ... ), t if the numbers are strictly increasing
+            auto less( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                return compare_in_order( args, argc, -1 );
+            }
 
-                std::cout << "define function !> " << function_name_symbol->value << std::endl;
-                current_scope->def_symbol( function_name_symbol->value, lambda_form, current_scope->make_inner_scope() );
+            // ( greater a b c ... ), t if the numbers are strictly decreasing
+            auto greater( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                return compare_in_order( args, argc, 1 );
+            }
 
-                return lambda_form;
+        private:
+            auto compare_in_order( node* const* const args, std::size_t const argc, int const order ) const
+                -> node*
+            {
+                for( std::size_t i=1; i<argc; ++i ) {
+                    if ( arithmetic<GC>::compare_numbers( args[i - 1], args[i] ) != order ) {
+                        return static_context::nil_object;
+                    }
+                }
+
+                return t_symbol_;
             }
 
-            auto make_lambda( cons* const n, std::shared_ptr<scope> const& current_scope )
+        private:
+            using binary_numeric_function = node* (arithmetic<GC>::*)( node* const, node* const );
+
+            // ( op a b c ... ) = ( ( a op b ) op c ) ...
+            auto fold_numbers(
+                node* const* const args,
+                std::size_t const argc,
+                node* const init,
+                binary_numeric_function const f
+                )
                 -> node*
             {
-                assert( !is_nil( n ) );
+                node* volatile result = init;
+                for( std::size_t i=0; i<argc; ++i ) {
+                    result = ( arith_.*f )( result, args[i] );
+                }
 
-                // check argument
-                cons* const first_n = n;
-                if ( !is_list( first_n ) || is_nil( first_n ) ) {
-                    assert( false && "missing lambda argument" );
+                return result;
+            }
+
+            // ( op a ) = ( identity op a ), ( op a b c ... ) = ( ( a op b ) op c ) ...
+            auto fold_inverse_numbers(
+                node* const* const args,
+                std::size_t const argc,
+                binary_numeric_function const f
+                )
+                -> node*
+            {
+                if ( argc == 1 ) {
+                    auto const identity = f == &arithmetic<GC>::subtract ? make_fixnum( 0 ) : make_fixnum( 1 );
+                    return ( arith_.*f )( identity, args[0] );
                 }
 
-                cons* const lambda_form = static_cast<cons* const>( first_n );
-                if ( !is_list( lambda_form->car ) ) {
-                    assert( false && "function argument must be list" );
+                return fold_numbers( args + 1, argc - 1, args[0], f );
+            }
+
+        private:
+            // ( make-vector size [initial-element] )
+            auto make_vector( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& size = args[0];
+                if ( !is_fixnum( size ) || fixnum_value( size ) < 0 ) {
+                    assert( false && "size of vector must be non negative integer" );
                 }
 
-                // set lambda form as callable!
-                lambda_form->set_attribute( node_attribute::e_callable );
+                auto&& init = argc > 1
+                    ? args[1]
+                    : static_context::nil_object;
 
-                return lambda_form;
+                return gc_->template make_object<vector_value>( fixnum_value( size ), init );
             }
 
-            auto progn( cons const* const n, std::shared_ptr<scope> const& current_scope )
+            // ( vref vector index )
+            auto vector_ref( node* const* const args, std::size_t const argc )
                 -> node*
             {
-                return eval_prog_n( n, current_scope );
+                auto&& v = args[0];
+                auto&& i = args[1];
+
+                return *vector_element_at( v, i );
             }
 
-            auto if_function( cons const* const n, std::shared_ptr<scope> const& current_scope )
+            // ( vset vector index value )
+            auto vector_set( node* const* const args, std::size_t const argc )
                 -> node*
             {
-                assert( !is_nil( n ) );
+                auto&& v = args[0];
+                auto&& i = args[1];
+                auto&& x = args[2];
 
-                cons const* const first = n;
+                *vector_element_at( v, i ) = x;
+                return x;
+            }
 
-                assert( is_list( first->cdr ) );
-                cons const* const second = static_cast<cons const* const>( first->cdr );
-                if ( is_nil( second ) ) {
-                    assert( false && "few arguments for if" );
+            // ( vlength vector )
+            auto vector_length( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& v = args[0];
+                if ( !is_vector( v ) ) {
+                    assert( false && "vector was required" );
                 }
 
-                auto&& condition = as_node( eval( first->car, current_scope ) );
+                return make_integer( *gc_, static_cast<vector_value const* const>( v )->elements.size() );
+            }
 
-                if( !is_nil( condition ) ) {
-                    // then
-                    return as_node( eval( second->car, current_scope ) );
+            auto vector_element_at( node* const v, node const* const i )
+                -> node**
+            {
+                if ( !is_vector( v ) ) {
+                    assert( false && "vector was required" );
+                }
+                auto&& elements = static_cast<vector_value* const>( v )->elements;
 
-                } else {
-                    // else
-                    if ( is_nil( second->cdr ) ) {
-                        return second->cdr;
+                if ( !is_fixnum( i ) || fixnum_value( i ) < 0 || static_cast<std::size_t>( fixnum_value( i ) ) >= elements.size() ) {
+                    assert( false && "index out of range" );
+                }
 
-                    } else {
-                        assert( is_list( second->cdr ) );
-                        return as_node( eval( static_cast<cons const* const>( second->cdr )->car, current_scope ) );
-                    }
+                return &elements[fixnum_value( i )];
+            }
+
+        private:
+            // ( make-int64-array size [initial-element] ), ( make-double-array size [initial-element] )
+            template<typename Array>
+            auto make_typed_array( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& size = args[0];
+                if ( !is_fixnum( size ) || fixnum_value( size ) < 0 ) {
+                    assert( false && "size of array must be non negative integer" );
+                }
+
+                typename Array::value_type init = 0;
+                if ( argc > 1 ) {
+                    unbox( args[1], init );
                 }
+
+                return gc_->template make_object<Array>( fixnum_value( size ), init );
+            }
+
+            // ( array-ref array index )
+            auto array_ref( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+                auto&& i = args[1];
+
+                return apply_typed_array( a, i, nullptr, &machine::ref_of<int64_array_value>, &machine::ref_of<double_array_value> );
+            }
+
+            // ( array-set array index value )
+            auto array_set( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+                auto&& i = args[1];
+                auto&& x = args[2];
+
+                return apply_typed_array( a, i, x, &machine::set_of<int64_array_value>, &machine::set_of<double_array_value> );
+            }
+
+            // ( array-length array )
+            auto array_length( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+
+                return apply_typed_array( a, nullptr, nullptr, &machine::length_of<int64_array_value>, &machine::length_of<double_array_value> );
+            }
+
+            // ( array-sum array )
+            auto array_sum( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+
+                return apply_typed_array( a, nullptr, nullptr, &machine::sum_of<int64_array_value>, &machine::sum_of<double_array_value> );
+            }
+
+            // ( array-dot array array )
+            auto array_dot( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+                auto&& b = args[1];
+
+                return apply_typed_array( a, b, nullptr, &machine::dot_of<int64_array_value>, &machine::dot_of<double_array_value> );
+            }
+
+            // ( array-add array array ), returns a new array
+            auto array_add( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+                auto&& b = args[1];
+
+                return apply_typed_array( a, b, nullptr, &machine::add_of<int64_array_value>, &machine::add_of<double_array_value> );
+            }
+
+            // ( array-mul array array ), returns a new array
+            auto array_mul( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+                auto&& b = args[1];
+
+                return apply_typed_array( a, b, nullptr, &machine::mul_of<int64_array_value>, &machine::mul_of<double_array_value> );
+            }
+
+            // ( array-scale array number ), returns a new array
+            auto array_scale( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+                auto&& k = args[1];
+
+                return apply_typed_array( a, k, nullptr, &machine::scale_of<int64_array_value>, &machine::scale_of<double_array_value> );
+            }
+
+            // ( array-min array )
+            auto array_min( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+
+                return apply_typed_array( a, nullptr, nullptr, &machine::min_of<int64_array_value>, &machine::min_of<double_array_value> );
+            }
+
+            // ( array-max array )
+            auto array_max( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+
+                return apply_typed_array( a, nullptr, nullptr, &machine::max_of<int64_array_value>, &machine::max_of<double_array_value> );
             }
 
         private:
-            std::shared_ptr<scope> scope_;
+            using typed_array_function = node* (machine::*)( node* const, node* const, node* const );
+
+            // selects the instance for the element type of the array
+            auto apply_typed_array(
+                node* const a,
+                node* const x,
+                node* const y,
+                typed_array_function const on_int64,
+                typed_array_function const on_double
+                )
+                -> node*
+            {
+                switch( type_of( a ) ) {
+                case node_type::e_int64_array:
+                    return ( this->*on_int64 )( a, x, y );
+
+                case node_type::e_double_array:
+                    return ( this->*on_double )( a, x, y );
+
+                default:
+                    assert( false && "typed array was required" );
+                    return nullptr;
+                }
+            }
+
+            template<typename Array>
+            auto ref_of( node* const a, node* const i, node* const )
+                -> node*
+            {
+                return box( *typed_array_element_at<Array>( a, i ) );
+            }
+
+            template<typename Array>
+            auto set_of( node* const a, node* const i, node* const x )
+                -> node*
+            {
+                unbox( x, *typed_array_element_at<Array>( a, i ) );
+                return x;
+            }
+
+            template<typename Array>
+            auto length_of( node* const a, node* const, node* const )
+                -> node*
+            {
+                return make_integer( *gc_, static_cast<Array const* const>( a )->values.size() );
+            }
+
+            template<typename Array>
+            auto sum_of( node* const a, node* const, node* const )
+                -> node*
+            {
+                auto&& v = static_cast<Array const* const>( a )->values;
+                return box( kernel::sum( v.data(), v.size() ) );
+            }
+
+            template<typename Array>
+            auto dot_of( node* const a, node* const b, node* const )
+                -> node*
+            {
+                auto&& l = static_cast<Array const* const>( a )->values;
+                auto&& r = same_shaped_array<Array>( a, b )->values;
+                return box( kernel::dot( l.data(), r.data(), l.size() ) );
+            }
+
+            template<typename Array>
+            auto add_of( node* const a, node* const b, node* const )
+                -> node*
+            {
+                return zip_with<Array>( a, b, &kernel::add );
+            }
+
+            template<typename Array>
+            auto mul_of( node* const a, node* const b, node* const )
+                -> node*
+            {
+                return zip_with<Array>( a, b, &kernel::mul );
+            }
+
+            template<typename Array>
+            auto scale_of( node* const a, node* const k, node* const )
+                -> node*
+            {
+                auto&& v = static_cast<Array const* const>( a )->values;
+
+                typename Array::value_type factor = 0;
+                unbox( k, factor );
+
+                auto&& result = gc_->template make_object<Array>( v.size(), 0 );
+                kernel::scale( v.data(), factor, result->values.data(), v.size() );
+
+                return result;
+            }
+
+            template<typename Array>
+            auto min_of( node* const a, node* const, node* const )
+                -> node*
+            {
+                auto&& v = non_empty_array<Array>( a )->values;
+                return box( kernel::min( v.data(), v.size() ) );
+            }
+
+            template<typename Array>
+            auto max_of( node* const a, node* const, node* const )
+                -> node*
+            {
+                auto&& v = non_empty_array<Array>( a )->values;
+                return box( kernel::max( v.data(), v.size() ) );
+            }
+
+            template<typename Array>
+            auto zip_with(
+                node* const a,
+                node* const b,
+                void (*kernel)( typename Array::value_type const*, typename Array::value_type const*, typename Array::value_type*, std::size_t )
+                )
+                -> node*
+            {
+                auto&& l = static_cast<Array const* const>( a )->values;
+                auto&& r = same_shaped_array<Array>( a, b )->values;
+
+                auto&& result = gc_->template make_object<Array>( l.size(), 0 );
+                kernel( l.data(), r.data(), result->values.data(), l.size() );
+
+                return result;
+            }
+
+            template<typename Array>
+            auto typed_array_element_at( node* const a, node const* const i )
+                -> typename Array::value_type*
+            {
+                auto&& values = static_cast<Array* const>( a )->values;
+
+                if ( !is_fixnum( i ) || fixnum_value( i ) < 0 || static_cast<std::size_t>( fixnum_value( i ) ) >= values.size() ) {
+                    assert( false && "index out of range" );
+                }
+
+                return &values[fixnum_value( i )];
+            }
+
+            template<typename Array>
+            auto same_shaped_array( node const* const a, node const* const b ) const
+                -> Array const*
+            {
+                if ( type_of( a ) != type_of( b ) ) {
+                    assert( false && "element types of arrays are mismatched" );
+                }
+                if ( static_cast<Array const* const>( a )->values.size() != static_cast<Array const* const>( b )->values.size() ) {
+                    assert( false && "lengths of arrays are mismatched" );
+                }
+
+                return static_cast<Array const* const>( b );
+            }
+
+            template<typename Array>
+            auto non_empty_array( node const* const a ) const
+                -> Array const*
+            {
+                if ( static_cast<Array const* const>( a )->values.empty() ) {
+                    assert( false && "array must not be empty" );
+                }
+
+                return static_cast<Array const* const>( a );
+            }
+
+            // conversion between boxed numbers and array elements
+            auto box( std::int64_t const v )
+                -> node*
+            {
+                return make_integer( *gc_, static_cast<long long>( v ) );
+            }
+
+            auto box( double const v )
+                -> node*
+            {
+                return gc_->template make_object<float_value>( v );
+            }
+
+            auto unbox( node const* const n, std::int64_t& v ) const
+                -> void
+            {
+                if ( is_fixnum( n ) ) {
+                    v = fixnum_value( n );
+
+                } else if ( is_integer( n ) && static_cast<bignum_value const* const>( n )->value.fits_long_long() ) {
+                    v = static_cast<bignum_value const* const>( n )->value.to_long_long();
+
+                } else {
+                    assert( false && "integer in the range of int64 was required" );
+                }
+            }
+
+            auto unbox( node const* const n, double& v ) const
+                -> void
+            {
+                if ( !is_number( n ) || is_complex( n ) ) {
+                    assert( false && "real number was required" );
+                }
+
+                v = arithmetic<GC>::to_double( n );
+            }
+
+        private:
+            // ( concat string ... ), copies texts into one new buffer
+            auto concat( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                std::vector<string_value const*> strings;
+                for( std::size_t i=0; i<argc; ++i ) {
+                    strings.push_back( as_string( args[i] ) );
+                }
+
+                std::size_t length = 0;
+                for( auto&& str : strings ) {
+                    length += str->length;
+                }
+
+                std::string text;
+                text.reserve( length );
+                for( auto&& str : strings ) {
+                    text.append( str->data(), str->length );
+                }
+
+                return gc_->template make_object<string_value>( std::move( text ) );
+            }
+
+            // ( substring string start [end] ), shares the buffer with the original string
+            auto substring( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& str = as_string( args[0] );
+                auto&& start = args[1];
+                auto&& end = argc > 2
+                    ? args[2]
+                    : make_fixnum( str->length );
+
+                if ( !is_fixnum( start ) || !is_fixnum( end )
+                     || fixnum_value( start ) < 0
+                     || fixnum_value( start ) > fixnum_value( end )
+                     || static_cast<std::size_t>( fixnum_value( end ) ) > str->length
+                    ) {
+                    assert( false && "index out of range" );
+                }
+
+                return gc_->template make_object<string_value>(
+                    str->buffer,
+                    str->offset + fixnum_value( start ),
+                    fixnum_value( end ) - fixnum_value( start )
+                    );
+            }
+
+            // ( string-length string )
+            auto string_length( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& str = as_string( args[0] );
+
+                return make_integer( *gc_, str->length );
+            }
+
+            auto as_string( node const* const n ) const
+                -> string_value const*
+            {
+                if ( !is_string( n ) ) {
+                    assert( false && "string was required" );
+                }
+
+                return static_cast<string_value const* const>( n );
+            }
+
+        private:
+            // ( make-hash-table )
+            auto make_hash_table( node* const* const, std::size_t const )
+                -> node*
+            {
+                return gc_->template make_object<hash_table_value>();
+            }
+
+            // ( gethash key table [default] )
+            auto get_hash( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& key = args[0];
+                auto&& table = args[1];
+
+                if ( auto&& value = as_hash_table( table )->find( key ) ) {
+                    return value;
+                }
+
+                return argc > 2
+                    ? args[2]
+                    : static_context::nil_object;
+            }
+
+            // ( puthash key value table )
+            auto put_hash( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& key = args[0];
+                auto&& value = args[1];
+                auto&& table = args[2];
+
+                as_hash_table( table )->insert( key, value );
+                return value;
+            }
+
+            // ( remhash key table ), returns the number of removed entries
+            auto remove_hash( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& key = args[0];
+                auto&& table = args[1];
+
+                return make_fixnum( as_hash_table( table )->erase( key ) ? 1 : 0 );
+            }
+
+            // ( hash-table-count table )
+            auto hash_table_count( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& table = args[0];
+
+                return make_integer( *gc_, as_hash_table( table )->size() );
+            }
+
+            auto as_hash_table( node* const n ) const
+                -> hash_table_value*
+            {
+                if ( !is_hash_table( n ) ) {
+                    assert( false && "hash table was required" );
+                }
+
+                return static_cast<hash_table_value* const>( n );
+            }
+
+        private:
+            // ( pmap key value ... )
+            auto make_pmap( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                node* volatile m = gc_->template make_object<pmap_value>( nullptr, 0 );
+                return assoc_pairs( static_cast<pmap_value*>( m ), args, argc );
+            }
+
+            // ( pmap-get map key [default] )
+            auto pmap_get( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& m = args[0];
+                auto&& key = args[1];
+
+                if ( auto&& value = pmap_find( as_pmap( m ), key ) ) {
+                    return value;
+                }
+
+                return argc > 2
+                    ? args[2]
+                    : static_context::nil_object;
+            }
+
+            // ( pmap-assoc map key value ... ), returns a new map
+            auto pmap_assoc_function( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& m = args[0];
+
+                return assoc_pairs( as_pmap( m ), args + 1, argc - 1 );
+            }
+
+            // ( pmap-dissoc map key ), returns a new map
+            auto pmap_dissoc_function( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& m = args[0];
+                auto&& key = args[1];
+
+                return pmap_dissoc( *gc_, as_pmap( m ), key );
+            }
+
+            // ( pmap-count map )
+            auto pmap_count( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& m = args[0];
+
+                return make_integer( *gc_, as_pmap( m )->size );
+            }
+
+            auto assoc_pairs( pmap_value* m, node* const* const pairs, std::size_t const size )
+                -> node*
+            {
+                if ( size % 2 != 0 ) {
+                    assert( false && "keys and values must be paired" );
+                }
+
+                pmap_value* volatile result = m;
+                for( std::size_t i=0; i<size; i+=2 ) {
+                    result = pmap_assoc( *gc_, result, pairs[i], pairs[i + 1] );
+                }
+
+                return result;
+            }
+
+            auto as_pmap( node* const n ) const
+                -> pmap_value*
+            {
+                if ( !is_pmap( n ) ) {
+                    assert( false && "pmap was required" );
+                }
+
+                return static_cast<pmap_value* const>( n );
+            }
+
+        private:
+            // ( make-bytevector size [fill] )
+            auto make_bytevector( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& size = args[0];
+                if ( !is_fixnum( size ) || fixnum_value( size ) < 0 ) {
+                    assert( false && "size of bytevector must be non negative integer" );
+                }
+
+                auto const fill = argc > 1
+                    ? unsigned_value( args[1], 0xff )
+                    : 0;
+
+                return gc_->template make_object<bytevector_value>( fixnum_value( size ), static_cast<unsigned char>( fill ) );
+            }
+
+            // ( map-file path ), returns nil if the file cannot be mapped.
+            // the bytevector is read only and the file is unmapped when it is collected
+            auto map_file( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& path = as_string( args[0] );
+
+                auto&& v = gc_->template make_object<bytevector_value>( 0, 0 );
+                if ( !v->map_file( path->str() ) ) {
+                    return static_context::nil_object;
+                }
+
+                return v;
+            }
+
+            // ( bytevector-length bytevector )
+            auto bytevector_length( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& v = as_bytevector( args[0] );
+
+                return make_integer( *gc_, v->size() );
+            }
+
+            // ( u8-ref bytevector offset )
+            auto u8_ref( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& v = as_bytevector( args[0] );
+                auto const offset = bytevector_offset( v, args[1], 1 );
+
+                return make_fixnum( v->data()[offset] );
+            }
+
+            // ( u8-set bytevector offset value )
+            auto u8_set( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& v = as_writable_bytevector( args[0] );
+                auto const offset = bytevector_offset( v, args[1], 1 );
+                auto&& x = args[2];
+
+                v->data()[offset] = static_cast<unsigned char>( unsigned_value( x, 0xff ) );
+                return x;
+            }
+
+            // ( u32-ref bytevector offset ), little endian
+            auto u32_ref( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& v = as_bytevector( args[0] );
+                auto const offset = bytevector_offset( v, args[1], 4 );
+
+                return make_integer( *gc_, static_cast<long long>( v->u32_at( offset ) ) );
+            }
+
+            // ( u32-set bytevector offset value ), little endian
+            auto u32_set( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& v = as_writable_bytevector( args[0] );
+                auto const offset = bytevector_offset( v, args[1], 4 );
+                auto&& x = args[2];
+
+                v->set_u32_at( offset, static_cast<std::uint32_t>( unsigned_value( x, 0xffffffff ) ) );
+                return x;
+            }
+
+            auto as_bytevector( node* const n ) const
+                -> bytevector_value*
+            {
+                if ( !is_bytevector( n ) ) {
+                    assert( false && "bytevector was required" );
+                }
+
+                return static_cast<bytevector_value* const>( n );
+            }
+
+            auto as_writable_bytevector( node* const n ) const
+                -> bytevector_value*
+            {
+                auto&& v = as_bytevector( n );
+                if ( v->is_read_only() ) {
+                    assert( false && "bytevector is read only" );
+                }
+
+                return v;
+            }
+
+            // index of [offset, offset+width) in the bytevector
+            auto bytevector_offset( bytevector_value const* const v, node const* const offset, std::size_t const width ) const
+                -> std::size_t
+            {
+                if ( !is_fixnum( offset ) || fixnum_value( offset ) < 0
+                     || static_cast<std::size_t>( fixnum_value( offset ) ) + width > v->size()
+                    ) {
+                    assert( false && "index out of range" );
+                }
+
+                return static_cast<std::size_t>( fixnum_value( offset ) );
+            }
+
+            auto unsigned_value( node const* const n, long long const max ) const
+                -> long long
+            {
+                if ( !is_fixnum( n ) || fixnum_value( n ) < 0 || fixnum_value( n ) > max ) {
+                    assert( false && "value out of range" );
+                }
+
+                return fixnum_value( n );
+            }
+
+        private:
+            auto quote( cons* const n, std::shared_ptr<scope> const& )
+                -> node*
+            {
+                assert( !is_nil( n ) );
+
+                return n;
+            }
+
+            // ( list a b ... ), macros build forms with it
+            auto list( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                return make_list( *gc_, args, args + argc, static_context::nil_object );
+            }
+
+            // ( hashcons x ), returns the shared node which is structurally equal to x
+            auto hashcons_function( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                return hashcons_->intern( args[0] );
+            }
+
+            // ( eq a b ), identity. integers are compared by value
+            auto eq( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& a = args[0];
+                auto&& b = args[1];
+
+                return a == b || ( is_integer( a ) && is_same_key( a, b ) )
+                    ? static_cast<node*>( t_symbol_ )
+                    : static_context::nil_object;
+            }
+
+            // ( car cell )
+            auto car_function( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                return car( as_cell( args[0] ) );
+            }
+
+            // ( cdr cell )
+            auto cdr_function( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                return cdr( as_cell( args[0] ) );
+            }
+
+            // ( setcar cell x )
+            auto set_car_function( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& x = args[1];
+
+                car_slot( as_cell( args[0] ) ) = x;
+                return x;
+            }
+
+            // ( setcdr cell x ). compact cells of lists are forwarded to new cons cells
+            auto set_cdr_function( node* const* const args, std::size_t const argc )
+                -> node*
+            {
+                auto&& x = args[1];
+
+                set_cdr( *gc_, as_cell( args[0] ), x );
+                return x;
+            }
+
+            auto as_cell( node* const n ) const
+                -> node*
+            {
+                if ( !is_list( n ) || is_nil( n ) ) {
+                    assert( false && "cons was required" );
+                }
+
+                return n;
+            }
+
+            auto define_function( cons* const n, std::shared_ptr<scope> const& current_scope )
+                -> node*
+            {
+                assert( !is_nil( n ) );
+
+                // check function name
+                cons const* const first = n;
+                if ( !is_symbol( car( first ) ) ) {
+                    assert( false && "function name must be symbol" );
+                }
+                symbol const* const function_name_symbol = static_cast<symbol const* const>( car( first ) );
+
+                // check argument
+                node* const second_n = cdr( first );
+                if ( !is_list( second_n ) || is_nil( second_n ) ) {
+                    assert( false && "missing lambda argument" );
+                }
+
+                node* const lambda_form
+                    = make_lambda( static_cast<cons* const>( second_n ), current_scope );
+
+                std::cout << "define function !> " << function_name_symbol->value << std::endl;
+                current_scope->def_symbol( function_name_symbol, lambda_form, current_scope->make_inner_scope() );
+
+                return lambda_form;
+            }
+
+            // ( defmacro name params body... ). the body makes a form from forms of arguments.
+            // macros are expanded when callers are compiled, so they are global and see no local variables
+            auto define_macro( cons* const n, std::shared_ptr<scope> const& )
+                -> node*
+            {
+                assert( !is_nil( n ) );
+
+                if ( !is_symbol( car( n ) ) ) {
+                    assert( false && "macro name must be symbol" );
+                }
+                symbol const* const macro_name_symbol = static_cast<symbol const* const>( car( n ) );
+
+                node* const lambda_form = cdr( n );
+                if ( !is_list( lambda_form ) || is_nil( lambda_form ) || !is_list( car( lambda_form ) ) ) {
+                    assert( false && "missing macro parameters" );
+                }
+
+                node* volatile const expander = compiler_.compile_lambda( lambda_form );
+                auto const macro = gc_->template make_object<macro_value>( expander );
+
+                std::cout << "define macro !> " << macro_name_symbol->value << std::endl;
+                scope_->def_symbol( macro_name_symbol, macro );
+
+                return macro;
+            }
+
+            auto make_lambda( cons* const n, std::shared_ptr<scope> const& current_scope )
+                -> node*
+            {
+                assert( !is_nil( n ) );
+
+                // check argument
+                cons* const first_n = n;
+                if ( !is_list( first_n ) || is_nil( first_n ) ) {
+                    assert( false && "missing lambda argument" );
+                }
+
+                cons* const lambda_form = static_cast<cons* const>( first_n );
+                if ( !is_list( car( lambda_form ) ) ) {
+                    assert( false && "function argument must be list" );
+                }
+
+                // set lambda form as callable!
+                lambda_form->set_attribute( node_attribute::e_callable );
+
+                return lambda_form;
+            }
+
+            auto progn( cons* const n, std::shared_ptr<scope> const& current_scope )
+                -> node*
+            {
+                return eval_prog_n( n, current_scope );
+            }
+
+            auto if_function( cons* const n, std::shared_ptr<scope> const& current_scope )
+                -> node*
+            {
+                assert( !is_nil( n ) );
+
+                cons const* const first = n;
+
+                assert( is_list( cdr( first ) ) );
+                cons const* const second = static_cast<cons const* const>( cdr( first ) );
+                if ( is_nil( second ) ) {
+                    assert( false && "few arguments for if" );
+                }
+
+                auto&& condition = as_node( eval( car( first ), current_scope ) );
+
+                if( !is_nil( condition ) ) {
+                    // then
+                    return as_node( eval( car( second ), current_scope ) );
+
+                } else {
+                    // else
+                    if ( is_nil( cdr( second ) ) ) {
+                        return cdr( second );
+
+                    } else {
+                        assert( is_list( cdr( second ) ) );
+                        return as_node( eval( car( cdr( second ) ), current_scope ) );
+                    }
+                }
+            }
+
+        private:
+            std::shared_ptr<scope> scope_;
             std::shared_ptr<GC> gc_;
+            arithmetic<GC> arith_;
+
+            keyword const* const rest_keyword_;
+            symbol* const t_symbol_;
+
+            std::shared_ptr<hashcons_table<GC>> hashcons_;
+            std::unordered_map<node const*, std::pair<macro_value const*, node*>> expansions_;
+
+            compiler<GC> compiler_;
+            vm<GC, machine> vm_;
+            std::vector<symbol const*> argument_symbols_;
         };
 
     } // namespace interpreter
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <functional>
+#include <memory>
+#include <cstddef>
+#include <cassert>
 
 #include "scope.hpp"
 #include "../node.hpp"
@@ -11,18 +13,62 @@ namespace yakkai
     //
     namespace interpreter
     {
+        // natives are plain functions called with the machine as context. special forms take forms
+        // of arguments, others take values of arguments with the arity fixed at registration
         struct native_function : public node
         {
-            using func_type = std::function<
-                node* (cons* const, std::shared_ptr<interpreter::scope> const&)
-                >;
+            using form_function_type = node* (*)( void*, cons* const, std::shared_ptr<interpreter::scope> const& );
+            using value_function_type = node* (*)( void*, node* const* const, std::size_t const );
 
-            explicit native_function( func_type const& f )
+            static constexpr std::size_t variadic = static_cast<std::size_t>( -1 );
+
+            native_function( form_function_type const f, void* const context )
                 : node( node_type::e_native_function, node_attribute::e_callable )
-                , f_( f )
+                , form_f_( f )
+                , value_f_( nullptr )
+                , context_( context )
+                , min_argc_( 0 )
+                , max_argc_( variadic )
                 {}
 
-            func_type f_;
+            native_function( value_function_type const f, void* const context, std::size_t const min_argc, std::size_t const max_argc )
+                : node( node_type::e_native_function, node_attribute::e_callable )
+                , form_f_( nullptr )
+                , value_f_( f )
+                , context_( context )
+                , min_argc_( min_argc )
+                , max_argc_( max_argc )
+                {}
+
+            auto is_special_form() const
+                -> bool
+            {
+                return form_f_ != nullptr;
+            }
+
+            auto apply_form( cons* const forms, std::shared_ptr<interpreter::scope> const& s ) const
+                -> node*
+            {
+                assert( is_special_form() );
+
+                return form_f_( context_, forms, s );
+            }
+
+            auto apply( node* const* const args, std::size_t const argc ) const
+                -> node*
+            {
+                assert( !is_special_form() );
+                if ( argc < min_argc_ || argc > max_argc_ ) {
+                    assert( false && "wrong number of arguments" );
+                }
+
+                return value_f_( context_, args, argc );
+            }
+
+            form_function_type const form_f_;
+            value_function_type const value_f_;
+            void* const context_;
+            std::size_t const min_argc_, max_argc_;
         };
 
     } // namespace interpreter
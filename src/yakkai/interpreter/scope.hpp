@@ -1,7 +1,7 @@
 #pragma once
 
 #include <memory>
-#include <map>
+#include <unordered_map>
 #include <list>
 #include <cassert>
 
@@ -25,21 +25,29 @@ namespace yakkai
             {}
 
         public:
-            auto def_symbol( std::string const& name, node* const n, std::shared_ptr<scope> const& s = nullptr )
+            auto def_symbol( symbol const* const name, node* const n, std::shared_ptr<scope> const& s = nullptr )
                 -> node*
             {
                 environment_[name] = std::make_pair( n, s );
+                ++version_;
 
                 return n;
             }
 
-            auto get_node_at( std::string const& name )
+            // changed whenever a symbol is defined in this scope. caches of the bindings compare it
+            auto version() const
+                -> std::size_t const&
+            {
+                return version_;
+            }
+
+            auto get_node_at( symbol const* const name )
                 -> node*
             {
                 return std::get<0>( environment_.at( name ) );
             }
 
-            auto get_scope_at( std::string const& name )
+            auto get_scope_at( symbol const* const name )
                 -> std::shared_ptr<scope>
             {
                 return std::get<1>( environment_.at( name ) );
@@ -82,7 +90,7 @@ namespace yakkai
                 return !parent_.expired();
             }
 
-            auto find( std::string const& name )
+            auto find( symbol const* const name )
                 -> std::tuple<node*, std::shared_ptr<scope>>
             {
                 auto&& it = environment_.find( name );
@@ -93,13 +101,21 @@ namespace yakkai
                 return std::forward_as_tuple( nullptr, nullptr );
             }
 
-            auto find_node( std::string const& name )
+            // entry of the name in this scope. it is made unbound (nullptr) if the name is not defined yet.
+            // the address is stable, def_symbol overwrites the same entry
+            auto entry_at( symbol const* const name )
+                -> std::pair<node*, std::shared_ptr<scope>>*
+            {
+                return &environment_[name];
+            }
+
+            auto find_node( symbol const* const name )
                 -> node*
             {
                 return std::get<0>( find( name ) );
             }
 
-            auto find_scope( std::string const& name )
+            auto find_scope( symbol const* const name )
                 -> std::shared_ptr<scope>
             {
                 return std::get<1>( find( name ) );
@@ -118,8 +134,10 @@ namespace yakkai
         private:
             std::weak_ptr<scope> parent_;
 
-            std::map<std::string, std::pair<node*, std::shared_ptr<scope>>> environment_;
+            // symbols are interned, so they are compared by identity
+            std::unordered_map<symbol const*, std::pair<node*, std::shared_ptr<scope>>> environment_;
             std::list<std::weak_ptr<scope>> inline_scopes_;
+            std::size_t version_ = 0;
         };
 
 
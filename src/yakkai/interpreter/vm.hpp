@@ -0,0 +1,512 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cassert>
+
+#include "../node.hpp"
+#include "../bytecode.hpp"
+#include "../static_context.hpp"
+#include "../util/math.hpp"
+#include "node.hpp"
+#include "jit.hpp"
+
+// jump to the next handler directly by address instead of going back to one switch
+#if defined(__GNUC__)
+# define YAKKAI_VM_THREADED_DISPATCH 1
+#endif
+
+
+namespace yakkai
+{
+    namespace interpreter
+    {
+        // stack vm which runs code_object. slots and operands of all frames are on one stack traced by gc.
+        // calls between compiled functions don't consume the native stack. code of hot functions is
+        // translated into machine code, which runs on the same stack until it leaves an instruction to the vm.
+        // natives, lambda forms and forms left to the tree-walker are called back through Machine
+        template<typename GC, typename Machine>
+        class vm
+        {
+            struct frame
+            {
+                code_object const* code;
+                instruction const* pc;      // where the caller resumes while its callee runs
+                node** base;                // slot 0. the callee is placed right under it
+            };
+
+        public:
+            static constexpr std::size_t stack_capacity = 1 << 20;
+
+            vm( std::shared_ptr<GC> const& gc, Machine& m )
+                : gc_( gc )
+                , machine_( m )
+                , stack_( new node*[stack_capacity] )
+                , sp_( stack_.get() )
+                , t_symbol_( static_context::intern_symbol( "t" ) )
+                , global_version_( &m.global_version() )
+            {
+                frames_.reserve( 256 );
+            }
+
+        public:
+            auto push( node* const n )
+                -> void
+            {
+                if ( sp_ == stack_.get() + stack_capacity ) {
+                    assert( false && "stack overflow" );
+                }
+
+                *sp_++ = n;
+            }
+
+            auto top() const
+                -> node**
+            {
+                return sp_;
+            }
+
+            auto drop( std::size_t const n )
+                -> void
+            {
+                sp_ -= n;
+            }
+
+            // calls the callee pushed before argc arguments. they are removed from the stack
+            auto call( std::size_t const argc )
+                -> node*
+            {
+                node** const callee_slot = sp_ - argc - 1;
+
+                if ( !is_function( *callee_slot ) ) {
+                    auto const result = machine_.apply_from_vm( *callee_slot, callee_slot + 1, argc );
+                    sp_ = callee_slot;
+                    return result;
+                }
+
+                auto const depth = frames_.size();
+                enter( static_cast<function_value const*>( *callee_slot ), argc );
+
+                return run( depth );
+            }
+
+            auto mark( std::function<void (node*)> const& marker ) const
+                -> void
+            {
+                for( node* const* p = stack_.get(); p != sp_; ++p ) {
+                    marker( *p );
+                }
+            }
+
+        private:
+            // arguments on the top become slots of the new frame
+            auto enter( function_value const* const f, std::size_t const argc )
+                -> void
+            {
+                auto&& code = *f->code;
+                node** const base = sp_ - argc;
+
+                if ( code.has_rest ? argc < code.param_num : argc != code.param_num ) {
+                    assert( false && "wrong number of arguments" );
+                }
+
+                auto const required = std::max( code.frame_size, argc ) + code.max_stack + 1;
+                if ( static_cast<std::size_t>( stack_.get() + stack_capacity - base ) < required ) {
+                    assert( false && "stack overflow" );
+                }
+
+                if ( code.has_rest ) {
+                    // rest of arguments stay on the stack while the list is made
+                    auto const rest = make_list( *gc_, base + code.param_num, base + argc, static_context::nil_object );
+                    base[code.param_num] = rest;
+                    sp_ = base + code.param_num + 1;
+                }
+
+                for( node** const end = base + code.frame_size; sp_ < end; ++sp_ ) {
+                    *sp_ = static_context::nil_object;
+                }
+
+                if ( ++code.call_count == jit_threshold ) {
+                    code.native = compile_to_native( code, t_symbol_ );
+                }
+
+                frames_.push_back( frame{ &code, code.instructions.data(), base } );
+            }
+
+            // runs until the frame at entry_depth returns
+            auto run( std::size_t const entry_depth )
+                -> node*
+            {
+                code_object const* code;
+                instruction const* pc;
+                node** base;
+                node* const* constants;
+
+                std::size_t argc;
+                node* callee;
+
+                auto const load = [&]() {
+                    auto&& f = frames_.back();
+                    code = f.code;
+                    pc = f.pc;
+                    base = f.base;
+                    constants = code->constants.data();
+                };
+
+#if defined(YAKKAI_VM_THREADED_DISPATCH)
+                // in the order of opcode
+                static void* const dispatch_table[] = {
+                    &&op_constant,
+                    &&op_local,
+                    &&op_store_local,
+                    &&op_free,
+                    &&op_set_free,
+                    &&op_global,
+                    &&op_pop,
+                    &&op_jump,
+                    &&op_jump_if_nil,
+                    &&op_jump_if_rebound,
+                    &&op_jump_if_macro,
+                    &&op_closure,
+                    &&op_call,
+                    &&op_tail_call,
+                    &&op_call_global,
+                    &&op_tail_call_global,
+                    &&op_return,
+                    &&op_define_global,
+                    &&op_eval_form,
+                    &&op_add,
+                    &&op_subtract,
+                    &&op_multiply,
+                    &&op_less,
+                    &&op_greater
+                };
+                static_assert( sizeof( dispatch_table ) / sizeof( dispatch_table[0] ) == opcode_num, "" );
+
+# define YAKKAI_VM_NEXT() goto *dispatch_table[static_cast<std::size_t>( pc->op )]
+# define YAKKAI_VM_OP( name ) op_##name:
+#else
+# define YAKKAI_VM_NEXT() goto dispatch
+# define YAKKAI_VM_OP( name ) case opcode::e_##name:
+#endif
+
+                load();
+                goto resume;
+
+#if !defined(YAKKAI_VM_THREADED_DISPATCH)
+            dispatch:
+                switch( pc->op ) {
+#endif
+                YAKKAI_VM_OP( constant )
+                    *sp_++ = constants[pc->a];
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( local )
+                    *sp_++ = base[pc->a];
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( store_local )
+                    base[pc->a] = *--sp_;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( free )
+                    *sp_++ = static_cast<function_value const*>( base[-1] )->free_values[pc->a];
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( set_free )
+                {
+                    // local functions whose deffun has not run yet are skipped
+                    node* const f = base[pc->a];
+                    --sp_;
+                    if ( is_function( f ) ) {
+                        static_cast<function_value*>( f )->free_values[pc->b] = *sp_;
+                    }
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+                }
+
+                YAKKAI_VM_OP( global )
+                {
+                    auto const v = *code->cells[pc->a];
+                    if ( v == nullptr ) {
+                        assert( false && "symbol was not found" );
+                    }
+
+                    *sp_++ = v;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+                }
+
+                YAKKAI_VM_OP( pop )
+                    --sp_;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( jump )
+                    pc = code->instructions.data() + pc->a;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( jump_if_nil )
+                    --sp_;
+                    pc = is_nil( *sp_ ) ? code->instructions.data() + pc->a : pc + 1;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( jump_if_rebound )
+                    pc = is_intact_builtin( code->guards[pc->b], callee ) ? pc + 1 : code->instructions.data() + pc->a;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( jump_if_macro )
+                    pc = is_macro_cell( code->call_sites[pc->b] ) ? code->instructions.data() + pc->a : pc + 1;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( closure )
+                {
+                    // values stay on the stack while the closure is allocated
+                    auto&& prototype = static_cast<function_value const*>( constants[pc->a] );
+                    auto const f = gc_->template make_object<function_value>( prototype->code );
+
+                    node** const values = sp_ - pc->b;
+                    f->free_values.assign( values, sp_ );
+                    sp_ = values;
+                    *sp_++ = f;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+                }
+
+                YAKKAI_VM_OP( call )
+                    argc = pc->a;
+                    ++pc;
+                    goto call_callee;
+
+                YAKKAI_VM_OP( tail_call )
+                    argc = pc->a;
+                    ++pc;
+                    goto tail_call_callee;
+
+                YAKKAI_VM_OP( call_global )
+                    argc = pc->b;
+                    insert_global_callee( code->call_sites[pc->a], argc );
+                    ++pc;
+                    goto call_callee;
+
+                YAKKAI_VM_OP( tail_call_global )
+                    argc = pc->b;
+                    insert_global_callee( code->call_sites[pc->a], argc );
+                    ++pc;
+                    goto tail_call_callee;
+
+            tail_call_callee:
+                {
+                    // natives return here, then the following instructions return the value
+                    node** const callee_slot = sp_ - argc - 1;
+                    if ( !is_function( *callee_slot ) ) goto call_callee;
+
+                    // the callee and arguments are moved down to the place of the returning function
+                    node** const dest = base - 1;
+                    std::memmove( dest, callee_slot, ( argc + 1 ) * sizeof( node* ) );
+                    sp_ = dest + argc + 1;
+                    frames_.pop_back();
+
+                    enter( static_cast<function_value const*>( *dest ), argc );
+                    load();
+                    goto resume;
+                }
+
+                YAKKAI_VM_OP( return )
+                {
+                    node* const result = sp_[-1];
+
+                    // the callee is also removed
+                    sp_ = base - 1;
+                    frames_.pop_back();
+                    if ( frames_.size() == entry_depth ) {
+                        return result;
+                    }
+
+                    *sp_++ = result;
+                    load();
+                    goto resume;
+                }
+
+                YAKKAI_VM_OP( define_global )
+                    machine_.define_global( static_cast<symbol const*>( constants[pc->a] ), sp_[-1] );
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( eval_form )
+                {
+                    auto const v = machine_.eval_with_locals( constants[pc->a], static_cast<function_value const*>( base[-1] ), code->slot_names[pc->b], base );
+                    *sp_++ = v;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+                }
+
+                YAKKAI_VM_OP( add )
+                    if ( !is_intact_builtin( code->guards[pc->a], callee ) ) goto call_redefined_builtin;
+                    if ( pc->b != 2 || !is_fixnum( sp_[-2] ) || !is_fixnum( sp_[-1] ) ) goto apply_builtin;
+
+                    // sum of two fixnums never overflows long long
+                    sp_[-2] = make_integer( *gc_, fixnum_value( sp_[-2] ) + fixnum_value( sp_[-1] ) );
+                    --sp_;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( subtract )
+                    if ( !is_intact_builtin( code->guards[pc->a], callee ) ) goto call_redefined_builtin;
+                    if ( pc->b != 2 || !is_fixnum( sp_[-2] ) || !is_fixnum( sp_[-1] ) ) goto apply_builtin;
+
+                    sp_[-2] = make_integer( *gc_, fixnum_value( sp_[-2] ) - fixnum_value( sp_[-1] ) );
+                    --sp_;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( multiply )
+                    if ( !is_intact_builtin( code->guards[pc->a], callee ) ) goto call_redefined_builtin;
+                    if ( pc->b != 2 || !is_fixnum( sp_[-2] ) || !is_fixnum( sp_[-1] ) ) goto apply_builtin;
+
+                    {
+                        long long r;
+                        if ( !checked_multiply( fixnum_value( sp_[-2] ), fixnum_value( sp_[-1] ), r ) ) goto apply_builtin;
+
+                        sp_[-2] = make_integer( *gc_, r );
+                    }
+                    --sp_;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( less )
+                    if ( !is_intact_builtin( code->guards[pc->a], callee ) ) goto call_redefined_builtin;
+                    if ( pc->b != 2 || !is_fixnum( sp_[-2] ) || !is_fixnum( sp_[-1] ) ) goto apply_builtin;
+
+                    sp_[-2] = fixnum_value( sp_[-2] ) < fixnum_value( sp_[-1] ) ? t_symbol_ : static_context::nil_object;
+                    --sp_;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+                YAKKAI_VM_OP( greater )
+                    if ( !is_intact_builtin( code->guards[pc->a], callee ) ) goto call_redefined_builtin;
+                    if ( pc->b != 2 || !is_fixnum( sp_[-2] ) || !is_fixnum( sp_[-1] ) ) goto apply_builtin;
+
+                    sp_[-2] = fixnum_value( sp_[-2] ) > fixnum_value( sp_[-1] ) ? t_symbol_ : static_context::nil_object;
+                    --sp_;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+
+#if !defined(YAKKAI_VM_THREADED_DISPATCH)
+                }
+                assert( false && "unknown opcode" );
+                return nullptr;
+#endif
+
+            apply_builtin:
+                {
+                    // arguments are not fixnums or not a pair
+                    node** const args = sp_ - pc->b;
+                    auto const v = static_cast<native_function const*>( code->guards[pc->a].native )->apply( args, pc->b );
+                    sp_ = args;
+                    *sp_++ = v;
+                    ++pc;
+                    YAKKAI_VM_NEXT();
+                }
+
+            call_redefined_builtin:
+                {
+                    // call the new value of the name as usual
+                    argc = pc->b;
+                    node** const args = sp_ - argc;
+                    std::memmove( args + 1, args, argc * sizeof( node* ) );
+                    *args = callee;
+                    ++sp_;
+                    ++pc;
+                    goto call_callee;
+                }
+
+            call_callee:
+                {
+                    node** const callee_slot = sp_ - argc - 1;
+
+                    if ( is_function( *callee_slot ) ) {
+                        frames_.back().pc = pc;
+                        enter( static_cast<function_value const*>( *callee_slot ), argc );
+                        load();
+                        goto resume;
+                    }
+
+                    auto const v = machine_.apply_from_vm( *callee_slot, callee_slot + 1, argc );
+                    sp_ = callee_slot;
+                    *sp_++ = v;
+                    goto resume;
+                }
+
+            resume:
+                // frames are entered or resumed here. translated code runs until it leaves an instruction
+                if ( code->native != nullptr ) {
+                    auto const index = code->native->run( base, &sp_, pc - code->instructions.data() );
+                    pc = code->instructions.data() + index;
+                }
+                YAKKAI_VM_NEXT();
+
+#undef YAKKAI_VM_OP
+#undef YAKKAI_VM_NEXT
+            }
+
+            // the callee is placed under argc arguments on the top
+            auto insert_global_callee( call_site const& site, std::size_t const argc )
+                -> void
+            {
+                if ( site.version != *global_version_ ) {
+                    site.callee = *site.cell;
+                    if ( site.callee == nullptr ) {
+                        assert( false && "symbol was not found" );
+                    }
+                    site.version = *global_version_;
+                }
+
+                // arguments are a few, so they are shifted one by one
+                for( node** p = sp_; p != sp_ - argc; --p ) {
+                    *p = p[-1];
+                }
+                sp_[-static_cast<std::ptrdiff_t>( argc )] = site.callee;
+                ++sp_;
+            }
+
+            // the name of the builtin is still bound to the native. otherwise callee takes the new value
+            static auto is_intact_builtin( builtin_guard const& guard, node*& callee )
+                -> bool
+            {
+                callee = *guard.cell;
+
+                return callee == guard.native;
+            }
+
+            // the name is bound to a macro now. the callee called last is never a macro
+            static auto is_macro_cell( call_site const& site )
+                -> bool
+            {
+                node* const v = *site.cell;
+
+                return v != site.callee && v != nullptr && is_macro( v );
+            }
+
+        private:
+            std::shared_ptr<GC> gc_;
+            Machine& machine_;
+
+            std::unique_ptr<node*[]> stack_;
+            node** sp_;
+            std::vector<frame> frames_;
+
+            node* const t_symbol_;
+            std::size_t const* const global_version_;
+        };
+
+    } // namespace interpreter
+} // namespace yakkai
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+
+#if defined(__unix__) || defined(__APPLE__)
+# include <sys/mman.h>
+# define YAKKAI_ARENA_USE_MMAP 1
+#endif
+
+
+namespace yakkai
+{
+    namespace memory
+    {
+        // contiguous virtual range which backs all pages of gc.
+        // pages are carved out of this range by bump allocation, so every heap object
+        // lies in [lower_bound(), upper_bound()).
+        class arena
+        {
+        public:
+            static constexpr std::size_t default_reserve_size = static_cast<std::size_t>( 1 ) << 30;  // 1GiB
+            static constexpr std::size_t commit_unit = static_cast<std::size_t>( 2 ) << 20;          // 2MiB (huge page)
+
+        public:
+            arena( std::size_t const reserve_size = default_reserve_size, bool const use_huge_page = true )
+                : reserved_size_( round_up( reserve_size, commit_unit ) )
+                , base_( nullptr )
+                , top_( nullptr )
+                , committed_end_( nullptr )
+                , mapped_( nullptr )
+                , mapped_size_( 0 )
+            {
+#if defined(YAKKAI_ARENA_USE_MMAP)
+                // reserve extra space to align base to the huge page boundary
+                mapped_size_ = reserved_size_ + commit_unit;
+                void* const p = ::mmap( nullptr, mapped_size_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+                if ( p == MAP_FAILED ) {
+                    throw std::bad_alloc();
+                }
+                mapped_ = static_cast<unsigned char*>( p );
+
+                base_ = reinterpret_cast<unsigned char*>(
+                    round_up( reinterpret_cast<std::uintptr_t>( mapped_ ), commit_unit )
+                    );
+# if defined(MADV_HUGEPAGE)
+                if ( use_huge_page ) {
+                    // failure is not fatal, pages are just not backed by THP
+                    ::madvise( base_, reserved_size_, MADV_HUGEPAGE );
+                }
+# endif
+#else
+                static_cast<void>( use_huge_page );
+
+                mapped_size_ = reserved_size_;
+                mapped_ = static_cast<unsigned char*>( std::malloc( mapped_size_ ) );
+                if ( mapped_ == nullptr ) {
+                    throw std::bad_alloc();
+                }
+                base_ = mapped_;
+#endif
+                top_ = base_;
+                committed_end_ = base_;
+            }
+
+            arena( arena const& ) = delete;
+            arena( arena&& ) = delete;
+
+            ~arena()
+            {
+#if defined(YAKKAI_ARENA_USE_MMAP)
+                ::munmap( mapped_, mapped_size_ );
+#else
+                std::free( mapped_ );
+#endif
+            }
+
+        public:
+            auto allocate( std::size_t const& size, std::size_t const& align )
+                -> unsigned char*
+            {
+                auto const p = reinterpret_cast<unsigned char*>(
+                    round_up( reinterpret_cast<std::uintptr_t>( top_ ), align )
+                    );
+                auto const new_top = p + size;
+                if ( new_top > base_ + reserved_size_ ) {
+                    // reserved range was exhausted
+                    return nullptr;
+                }
+
+                if ( new_top > committed_end_ ) {
+                    if ( !commit( new_top ) ) return nullptr;
+                }
+
+                top_ = new_top;
+                return p;
+            }
+
+        public:
+            // an address outside of this range can never be a heap object
+            inline auto is_included( void const* const p ) const
+                -> bool
+            {
+                return p >= base_ && p < top_;
+            }
+
+            inline auto lower_bound() const
+                -> unsigned char const*
+            {
+                return base_;
+            }
+
+            inline auto upper_bound() const
+                -> unsigned char const*
+            {
+                return top_;
+            }
+
+            inline auto used_size() const
+                -> std::size_t
+            {
+                return static_cast<std::size_t>( top_ - base_ );
+            }
+
+            inline auto committed_size() const
+                -> std::size_t
+            {
+                return static_cast<std::size_t>( committed_end_ - base_ );
+            }
+
+        private:
+            auto commit( unsigned char* const required_end )
+                -> bool
+            {
+                auto const new_end = reinterpret_cast<unsigned char*>(
+                    round_up( reinterpret_cast<std::uintptr_t>( required_end ), commit_unit )
+                    );
+                assert( new_end <= base_ + reserved_size_ );
+
+#if defined(YAKKAI_ARENA_USE_MMAP)
+                auto const size = static_cast<std::size_t>( new_end - committed_end_ );
+                if ( ::mprotect( committed_end_, size, PROT_READ | PROT_WRITE ) != 0 ) {
+                    return false;
+                }
+#endif
+                committed_end_ = new_end;
+                return true;
+            }
+
+        private:
+            template<typename T>
+            static constexpr auto round_up( T const v, std::size_t const align )
+                -> T
+            {
+                return ( v + align - 1 ) / align * align;
+            }
+
+        private:
+            std::size_t reserved_size_;
+
+            unsigned char* base_;
+            unsigned char* top_;
+            unsigned char* committed_end_;
+
+            unsigned char* mapped_;
+            std::size_t mapped_size_;
+        };
+
+    } // namespace memory
+} // namespace yakkai
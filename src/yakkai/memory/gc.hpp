@@ -6,18 +6,32 @@
 #include <unordered_map>
 #include <vector>
 #include <typeindex>
+#include <chrono>
 #include <cstdlib>
+#include <cstddef>
 
 #include <iostream>
 
+#include "arena.hpp"
 #include "page.hpp"
 #include "../node.hpp"
+#include "../hash_table.hpp"
+#include "../pmap.hpp"
+#include "../bytecode.hpp"
 #include "../util/math.hpp"
 
 namespace yakkai
 {
     namespace memory
     {
+        //
+        struct collection_info
+        {
+            std::size_t freed_num;
+            std::chrono::nanoseconds pause;
+        };
+
+
         //
         class gc
         {
@@ -42,6 +56,29 @@ namespace yakkai
                 custom_marker_ = std::forward<F>( f );
             }
 
+            // f will be called after each collection
+            template<typename F>
+            auto on_collected( F&& f )
+                -> void
+            {
+                collection_listener_ = std::forward<F>( f );
+            }
+
+            // f will be called between marking and sweeping with a predicate which tells whether
+            // an object survives this collection. tables which refer objects weakly drop dead entries by it
+            template<typename F>
+            auto on_marked( F&& f )
+                -> void
+            {
+                weak_reference_sweeper_ = std::forward<F>( f );
+            }
+
+            inline auto heap_size() const
+                -> std::size_t
+            {
+                return heap_.used_size();
+            }
+
         public:
             template<typename T, typename... Args>
             auto make_object( Args&&... args )
@@ -68,6 +105,13 @@ namespace yakkai
                     if ( p != nullptr ) return p;   // Succeeded!
                 }
 
+                // freed objects were of other types
+                add_page<T>( block_size );
+                {
+                    auto p = try_to_allocate<T>( block_size, std::forward<Args>( args )... );
+                    if ( p != nullptr ) return p;   // Succeeded!
+                }
+
                 // if reached to this flow, totally failed...
                 assert( false );
             }
@@ -87,7 +131,12 @@ namespace yakkai
             auto add_page( std::size_t const& block_size )
                 -> void
             {
-                auto p = std::make_shared<page>( block_size, []( void* p ) {
+                auto const data = heap_.allocate( page::size_for( block_size ), alignof( std::max_align_t ) );
+                if ( data == nullptr ) {
+                    assert( false && "heap was exhausted" );
+                }
+
+                auto p = std::make_shared<page>( data, block_size, []( void* p ) {
                         // TODO: check default destructable
                         auto obj = static_cast<T*>( p );
                         //print2( obj );
@@ -95,12 +144,11 @@ namespace yakkai
                         obj->~T();
                     } );
 
+                // pages are carved from the arena in ascending order, so sorted_pages_ is kept sorted
+                assert( sorted_pages_.empty() || *sorted_pages_.back() < *p );
+
                 pages_.emplace( typeid( T ), p );
                 sorted_pages_.emplace_back( p );
-
-                std::sort( sorted_pages_.begin(), sorted_pages_.end(), []( std::shared_ptr<page> const& r, std::shared_ptr<page> const& l ) {
-                        return *r < *l;
-                    } );
             }
 
             template<typename T, typename... Args>
@@ -130,7 +178,11 @@ namespace yakkai
             auto full_collect()
                 -> std::size_t
             {
+#if !defined(YAKKAI_GC_QUIET)
                 std::cout << "gc: full collect" << std::endl;
+#endif
+                auto const begin_time = std::chrono::steady_clock::now();
+
                 //
                 mark_stack();
 
@@ -143,7 +195,21 @@ namespace yakkai
                     custom_marker_( std::bind( &gc::mark_object, this, _1 ) );
                 }
 
-                return sweep();
+                if ( weak_reference_sweeper_ ) {
+                    using namespace std::placeholders;
+                    weak_reference_sweeper_( std::bind( &gc::is_surviving, this, _1 ) );
+                }
+
+                auto const freed_num = sweep();
+
+                if ( collection_listener_ ) {
+                    collection_listener_( collection_info{
+                            freed_num,
+                            std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - begin_time )
+                        } );
+                }
+
+                return freed_num;
             }
 
         private:
@@ -169,24 +235,119 @@ namespace yakkai
             auto mark_object( node* n )
                 -> void
             {
-                // std::cout << "??? -> " << n << std::endl;
-
-                // TODO: fix to binary searching to find pages
-                for( auto&& target_page : sorted_pages_ ) {
-                    if ( target_page->is_included( n ) ) {
-                        target_page->mark( n );
-                        // std::cout << "!!!!!!!! MARKED: " << (void*)n << "  ";
-                        // print2( n );
-
-                        if ( is_list( n ) && !is_nil( n ) ) {
-                            auto* l = static_cast<cons*>( n );
-                            mark_object( l->car );
-                            mark_object( l->cdr );
+                // fixnums are immediate values, not pointers
+                while( !is_fixnum( n ) && heap_.is_included( n ) ) {
+                    auto&& target_page = find_page( n );
+                    if ( target_page == nullptr ) return;
+
+                    // n may be an interior pointer (from the stack), so take the head of the object
+                    n = reinterpret_cast<node*>( target_page->find_object( n ) );
+                    if ( n == nullptr ) return;
+
+                    if ( !target_page->mark( n ) ) return;  // already marked
+
+                    if ( is_list( n ) && !is_nil( n ) ) {
+                        // a run of compact cells is one block, so n is its first cell.
+                        // car of a forwarded cell is its replacement, it is marked in the same way
+                        while( n->flags & cons_flag::e_cdr_next ) {
+                            auto* const c = static_cast<compact_cons*>( n );
+                            mark_object( c->car );
+                            n = c + 1;
                         }
+
+                        auto* l = static_cast<cons*>( n );
+                        mark_object( l->car );
+
+                        // follow cdr by loop to avoid deep recursion for long lists
+                        n = l->cdr;
+
+                    } else {
+                        mark_children( n );
+                        return;
+                    }
+                }
+            }
+
+            // objects outside of the heap are never collected
+            auto is_surviving( node const* const n ) const
+                -> bool
+            {
+                if ( is_fixnum( n ) || !heap_.is_included( n ) ) return true;
+
+                auto&& target_page = find_page( n );
+                return target_page != nullptr && target_page->is_marked_object( n );
+            }
+
+            // objects other than cons
+            auto mark_children( node* const n )
+                -> void
+            {
+                switch( n->type ) {
+                case node_type::e_vector:
+                    for( auto&& e : static_cast<vector_value*>( n )->elements ) {
+                        mark_object( e );
+                    }
+                    break;
+
+                case node_type::e_hash_table:
+                    static_cast<hash_table_value*>( n )->for_each( [this]( node* const key, node* const value ) {
+                            mark_object( key );
+                            mark_object( value );
+                        } );
+                    break;
+
+                case node_type::e_pmap:
+                    mark_object( static_cast<pmap_value*>( n )->root );
+                    break;
+
+                case node_type::e_hamt_node:
+                    for( auto&& e : static_cast<hamt_node*>( n )->slots ) {
+                        mark_object( e );
+                    }
+                    break;
+
+                case node_type::e_function:
+                {
+                    auto&& f = static_cast<function_value*>( n );
+                    mark_object( f->code->source );
+                    for( auto&& e : f->code->constants ) {
+                        mark_object( e );
+                    }
+                    for( auto&& g : f->code->guards ) {
+                        mark_object( g.native );
                     }
+                    for( auto&& e : f->free_values ) {
+                        mark_object( e );
+                    }
+                    break;
+                }
+
+                case node_type::e_macro:
+                    mark_object( static_cast<macro_value*>( n )->expander );
+                    break;
+
+                default:
+                    break;
                 }
             }
 
+            auto find_page( void const* const p ) const
+                -> page*
+            {
+                // find the last page whose head is not greater than p
+                auto it = std::upper_bound(
+                    sorted_pages_.cbegin(),
+                    sorted_pages_.cend(),
+                    p,
+                    []( void const* const p, std::shared_ptr<page> const& pg ) {
+                        return p < pg->head();
+                    } );
+                if ( it == sorted_pages_.cbegin() ) return nullptr;
+                --it;
+
+                return (*it)->is_included( p ) ? it->get() : nullptr;
+            }
+
         private:
             auto sweep()
                 -> std::size_t
@@ -199,8 +360,12 @@ namespace yakkai
             }
 
         private:
+            arena heap_;
+
             std::uintptr_t stack_begin_;
             std::function<void (std::function<void (node*)> const&)> custom_marker_;
+            std::function<void (collection_info const&)> collection_listener_;
+            std::function<void (std::function<bool (node const*)> const&)> weak_reference_sweeper_;
 
             std::unordered_multimap<std::type_index, std::shared_ptr<page>> pages_;
             std::vector<std::shared_ptr<page>> sorted_pages_;
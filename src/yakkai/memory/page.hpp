@@ -21,24 +21,25 @@ namespace yakkai
             using pointer_type = unsigned char*;
 
         public:
-            page( std::size_t const& block_size )
+            // data must point to the storage of size_for( block_size ) bytes. page doesn't own it
+            page( pointer_type const data, std::size_t const& block_size )
                 : block_size_( block_size )
-                , total_size_( block_size < block_max ? block_max : block_size )
+                , total_size_( size_for( block_size ) )
                 , capacity_num_( block_size < block_max ? ( block_max / block_size ) : 1 )
                 , object_num_( 0 )
-                , data_( new unsigned char[total_size_] )
+                , data_( data )
                 , free_bitmap_{}
                 , mark_bitmap_{}
             {
                 assert( block_size >= 4 );
             }
 
-            page( std::size_t const& block_size, std::function<void (void*)> const& deleter )
+            page( pointer_type const data, std::size_t const& block_size, std::function<void (void*)> const& deleter )
                 : block_size_( block_size )
-                , total_size_( block_size < block_max ? block_max : block_size )
+                , total_size_( size_for( block_size ) )
                 , capacity_num_( block_size < block_max ? ( block_max / block_size ) : 1 )
                 , object_num_( 0 )
-                , data_( new unsigned char[total_size_] )
+                , data_( data )
                 , free_bitmap_{}
                 , mark_bitmap_{}
                 , deleter_( deleter )
@@ -50,7 +51,13 @@ namespace yakkai
             ~page()
             {
                 destruct_objects();
-                delete[] data_;
+            }
+
+        public:
+            static constexpr auto size_for( std::size_t const& block_size )
+                -> std::size_t
+            {
+                return block_size < block_max ? block_max : block_size;
             }
 
         public:
@@ -89,6 +96,10 @@ namespace yakkai
                             // std::cout << "DESTRUCT: " << std::endl;
                             destruct_object( i );
                             ++n;
+
+                        } else {
+                            // survived. clear the mark for the next collection
+                            unmark( i );
                         }
                     }
                 }
@@ -132,6 +143,12 @@ namespace yakkai
                 return object_num_ >= capacity_num_;
             }
 
+            inline auto head() const
+                -> void const*
+            {
+                return data_;
+            }
+
             inline auto is_included( void const* const p ) const
                 -> bool
             {
@@ -160,12 +177,32 @@ namespace yakkai
             }
 
         public:
+            // returns a head of the living object which contains p, or nullptr
+            inline auto find_object( void const* const p )
+                -> pointer_type
+            {
+                auto const i = get_index_from_pointer( p );
+                if ( i >= capacity_num_ || !is_used( i ) ) return nullptr;
+
+                return get_block_from_index( i );
+            }
+
+            // returns false if the object has been already marked
             template<typename T>
             auto mark( T const* const np )
-                -> void
+                -> bool
             {
                 auto const i = get_index_from_pointer( np );
+                if ( is_marked( i ) ) return false;
+
                 bit_set( i, mark_bitmap_ );
+                return true;
+            }
+
+            inline auto is_marked_object( void const* const p ) const
+                -> bool
+            {
+                return is_marked( get_index_from_pointer( p ) );
             }
 
             inline auto sweep()
@@ -326,7 +363,7 @@ namespace yakkai
             std::size_t capacity_num_;
             std::size_t object_num_;
 
-            unsigned char* data_;
+            pointer_type data_;
             std::array<std::uint64_t, block_max/4> free_bitmap_;
             std::array<std::uint64_t, block_max/4> mark_bitmap_;
 
@@ -1,13 +1,20 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <memory>
+#include <iterator>
+#include <limits>
+#include <cstdint>
 #include <cassert>
 
+#include "util/bigint.hpp"
+#include "util/math.hpp"
+
 
 namespace yakkai
 {
-    enum struct node_type
+    enum struct node_type : std::uint8_t
     {
         e_none,
 
@@ -22,7 +29,20 @@ namespace yakkai
         e_integer,
         e_ratio,
         e_float,
-        e_complex
+        e_complex,
+
+        // aggregate
+        e_vector,
+        e_int64_array,
+        e_double_array,
+        e_hash_table,
+        e_pmap,
+        e_hamt_node,
+        e_bytevector,
+
+        // code
+        e_function,
+        e_macro
     };
 
 
@@ -50,6 +70,24 @@ namespace yakkai
             return "FLOAT";
         case node_type::e_complex:
             return "COMPLEX";
+        case node_type::e_vector:
+            return "VECTOR";
+        case node_type::e_int64_array:
+            return "INT64_ARRAY";
+        case node_type::e_double_array:
+            return "DOUBLE_ARRAY";
+        case node_type::e_hash_table:
+            return "HASH_TABLE";
+        case node_type::e_pmap:
+            return "PMAP";
+        case node_type::e_hamt_node:
+            return "HAMT_NODE";
+        case node_type::e_bytevector:
+            return "BYTEVECTOR";
+        case node_type::e_function:
+            return "FUNCTION";
+        case node_type::e_macro:
+            return "MACRO";
         default:
             return "%";
         }
@@ -57,19 +95,20 @@ namespace yakkai
 
 
     //
-    enum class node_attribute
+    enum class node_attribute : std::uint8_t
     {
         e_none,
         e_callable
     };
 
 
-    //
+    // header of all heap objects. packed into one 32bit word
     struct node
     {
         node( node_type const& t, node_attribute const& a = node_attribute::e_none )
             : type( t )
             , attr( a )
+            , flags( 0 )
         {}
 
         auto set_attribute( node_attribute const& a )
@@ -80,7 +119,9 @@ namespace yakkai
 
         node_type type;
         node_attribute attr;
+        std::uint16_t flags;    // spare bits for gc and representations
     };
+    static_assert( sizeof( node ) == 4, "node header must be packed into one word" );
 
 
     //
@@ -101,6 +142,38 @@ namespace yakkai
     };
 
 
+    // flags of list cells
+    struct cons_flag
+    {
+        static constexpr std::uint16_t e_cdr_next = 0x1;    // cdr is the cell which follows this one (cdr-coding)
+        static constexpr std::uint16_t e_forwarded = 0x2;   // car holds the cons which replaced this cell
+    };
+
+    // cell of cdr-coded lists. it has no cdr field, so cells must be accessed by car()/cdr()
+    struct compact_cons : public node
+    {
+        compact_cons()
+            : node( node_type::e_list )
+        {
+            flags = cons_flag::e_cdr_next;
+        }
+
+        node* car = nullptr;
+    };
+    static_assert( sizeof( compact_cons ) == 16, "compact cell must be 2/3 of cons" );
+
+    // a run of N elements allocated as one block. the last element is a normal cons
+    // which holds the rest of the list
+    template<std::size_t N>
+    struct compact_run
+    {
+        static_assert( N >= 2, "" );
+
+        compact_cons cells[N-1];
+        cons last;
+    };
+
+
     //
     struct symbol : public node
     {
@@ -128,61 +201,495 @@ namespace yakkai
     };
 
 
-    //
-    struct integer_value : public node
+    // integer which doesn't fit in fixnum
+    struct bignum_value : public node
     {
-        integer_value( long long int const& v )
+        bignum_value( bigint const& v )
             : node( node_type::e_integer )
             , value( v )
         {}
 
-        long long int value;
+        bigint value;
+    };
+
+
+    // small integers are not allocated. they are encoded in the pointer itself as ( value << 1 ) | 1.
+    // all heap objects are aligned, so the lowest bit of their addresses is always 0.
+    constexpr std::uintptr_t fixnum_tag = 1;
+    constexpr long long fixnum_max = std::numeric_limits<std::intptr_t>::max() >> 1;
+    constexpr long long fixnum_min = std::numeric_limits<std::intptr_t>::min() >> 1;
+
+    inline auto is_fixnum( node const* const n )
+        -> bool
+    {
+        return ( reinterpret_cast<std::uintptr_t>( n ) & fixnum_tag ) != 0;
+    }
+
+    inline auto is_fixnum_range( long long const v )
+        -> bool
+    {
+        return v >= fixnum_min && v <= fixnum_max;
+    }
+
+    inline auto make_fixnum( long long const v )
+        -> node*
+    {
+        assert( is_fixnum_range( v ) );
+        return reinterpret_cast<node*>( ( static_cast<std::uintptr_t>( v ) << 1 ) | fixnum_tag );
+    }
+
+    inline auto fixnum_value( node const* const n )
+        -> long long
+    {
+        assert( is_fixnum( n ) );
+        return static_cast<long long>( reinterpret_cast<std::intptr_t>( n ) >> 1 );
+    }
+
+    // type of n. immediate values don't have their node header
+    inline auto type_of( node const* const n )
+        -> node_type
+    {
+        return is_fixnum( n ) ? node_type::e_integer : n->type;
+    }
+
+    // fixnum if v is small enough, otherwise bignum
+    template<typename GC>
+    auto make_integer( GC& gc, long long const v )
+        -> node*
+    {
+        if ( is_fixnum_range( v ) ) {
+            return make_fixnum( v );
+        }
+
+        return gc.template make_object<bignum_value>( bigint( v ) );
+    }
+
+    template<typename GC>
+    auto make_integer( GC& gc, bigint const& v )
+        -> node*
+    {
+        if ( v.fits_long_long() && is_fixnum_range( v.to_long_long() ) ) {
+            return make_fixnum( v.to_long_long() );
+        }
+
+        return gc.template make_object<bignum_value>( v );
+    }
+
+    // numerator / denominator. always normalized, denominator > 1
+    struct ratio_value : public node
+    {
+        ratio_value( bigint const& n, bigint const& d )
+            : node( node_type::e_ratio )
+            , numerator( n )
+            , denominator( d )
+        {}
+
+        bigint numerator, denominator;
     };
 
+    // returns an integer if the denominator becomes 1
+    template<typename GC>
+    auto make_ratio( GC& gc, bigint n, bigint d )
+        -> node*
+    {
+        assert( !d.is_zero() && "division by zero" );
+
+        if ( d.is_negative() ) {
+            n = -n;
+            d = -d;
+        }
+
+        // most ratios consist of small numbers
+        if ( n.fits_long_long() && d.fits_long_long()
+             && is_fixnum_range( n.to_long_long() ) && is_fixnum_range( d.to_long_long() ) ) {
+            auto const ln = n.to_long_long();
+            auto const ld = d.to_long_long();
+            auto const g = gcd( ln < 0 ? -ln : ln, ld );
+            if ( g == ld ) {
+                return make_fixnum( ln / g );
+            }
+
+            return gc.template make_object<ratio_value>( bigint( ln / g ), bigint( ld / g ) );
+        }
+
+        auto const g = bigint::gcd( n, d );
+        if ( g == d ) {
+            return make_integer( gc, n / g );
+        }
+
+        return gc.template make_object<ratio_value>( n / g, d / g );
+    }
+
 
     //
     struct float_value : public node
     {
-        float_value( std::string const& number, std::string exp = "" )
+        float_value( double const v )
             : node( node_type::e_float )
-            , number( number )
-            , exp( exp )
+            , value( v )
         {}
 
-        std::string number, exp;
         double value;
     };
 
 
+    //
+    struct complex_value : public node
+    {
+        complex_value( double const r, double const i )
+            : node( node_type::e_complex )
+            , real( r )
+            , imag( i )
+        {}
+
+        double real, imag;
+    };
+
+
+    // simple vector. elements are contiguous and traced by gc
+    struct vector_value : public node
+    {
+        vector_value( std::size_t const size, node* const init )
+            : node( node_type::e_vector )
+            , elements( size, init )
+        {}
+
+        std::vector<node*> elements;
+    };
+
+
+    // text is a slice [offset, offset+length) of an immutable shared buffer.
+    // literals refer to the source code and substrings refer to their origin without copying
+    struct string_value : public node
+    {
+        using buffer_type = std::shared_ptr<std::string const>;
+
+        string_value( buffer_type const& b, std::size_t const o, std::size_t const l )
+            : node( node_type::e_string )
+            , buffer( b )
+            , offset( o )
+            , length( l )
+        {
+            assert( offset + length <= buffer->size() );
+        }
+
+        explicit string_value( std::string s )
+            : node( node_type::e_string )
+            , buffer( std::make_shared<std::string const>( std::move( s ) ) )
+            , offset( 0 )
+            , length( buffer->size() )
+        {}
+
+        inline auto data() const
+            -> char const*
+        {
+            return buffer->data() + offset;
+        }
+
+        inline auto str() const
+            -> std::string
+        {
+            return std::string( data(), length );
+        }
+
+        buffer_type buffer;
+        std::size_t offset, length;
+    };
+
+
+    // unboxed numeric array. values are kept out of the traced heap, so gc never scans them
+    template<typename T, node_type Type>
+    struct typed_array_value : public node
+    {
+        using value_type = T;
+
+        typed_array_value( std::size_t const size, T const init )
+            : node( Type )
+            , values( size, init )
+        {}
+
+        std::vector<T> values;
+    };
+
+    using int64_array_value = typed_array_value<std::int64_t, node_type::e_int64_array>;
+    using double_array_value = typed_array_value<double, node_type::e_double_array>;
+
+
+    ///
+    /// predicates. these are inlined to be a load and a compare in most cases
+    ///
+
+
+    inline auto is_nil( node const* const n )
+        -> bool
+    {
+        assert( n != nullptr );
+
+        if ( is_fixnum( n ) || n->type != node_type::e_list ) {
+            return false;
+        }
+
+        // compact cells are never nil
+        if ( n->flags & ( cons_flag::e_cdr_next | cons_flag::e_forwarded ) ) {
+            return false;
+        }
+
+        auto&& c = static_cast<cons const* const>( n );
+        return c->car == nullptr && c->cdr == nullptr;
+    }
+
+    inline auto is_atom( node const* const n )
+        -> bool
+    {
+        return type_of( n ) != node_type::e_list || is_nil( n );
+    }
+
+    // nil is also a list
+    inline auto is_list( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_list;
+    }
+
+    inline auto is_symbol( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_symbol;
+    }
+
+    inline auto is_keyword( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_keyword;
+    }
+
+    inline auto is_native_function( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_native_function;
+    }
+
+    inline auto is_string( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_string;
+    }
+
+    inline auto is_integer( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_integer;
+    }
+
+    inline auto is_ratio( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_ratio;
+    }
+
+    inline auto is_float( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_float;
+    }
+
+    inline auto is_complex( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_complex;
+    }
+
+    inline auto is_vector( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_vector;
+    }
+
+    inline auto is_typed_array( node const* const n )
+        -> bool
+    {
+        auto const t = type_of( n );
+        return t == node_type::e_int64_array || t == node_type::e_double_array;
+    }
+
+    inline auto is_hash_table( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_hash_table;
+    }
+
+    inline auto is_pmap( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_pmap;
+    }
+
+    inline auto is_bytevector( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_bytevector;
+    }
+
+    inline auto is_function( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_function;
+    }
+
+    inline auto is_macro( node const* const n )
+        -> bool
+    {
+        return type_of( n ) == node_type::e_macro;
+    }
+
+    inline auto is_number( node const* const n )
+        -> bool
+    {
+        auto const t = type_of( n );
+        return t == node_type::e_integer || t == node_type::e_ratio || t == node_type::e_float || t == node_type::e_complex;
+    }
+
+    inline auto is_callable( node const* const n )
+        -> bool
+    {
+        return !is_fixnum( n ) && n->attr == node_attribute::e_callable;
+    }
+
+
     ///
+    /// list accessors. these hide cdr-coded cells, so lists must not be read through fields of cons
     ///
 
 
-    auto is_nil( node const* const n )
-        -> bool;
+    namespace detail
+    {
+        // replacement of the cell when its cdr was modified
+        inline auto resolve_cell( node const* const n )
+            -> node const*
+        {
+            assert( is_list( n ) );
 
-    auto is_atom( node const* const n )
-        -> bool;
-    auto is_list( node const* const n )
-        -> bool;
+            return ( n->flags & cons_flag::e_forwarded )
+                ? static_cast<compact_cons const* const>( n )->car
+                : n;
+        }
+    } // namespace detail
 
-    auto is_symbol( node const* const n )
-        -> bool;
+    inline auto car_slot( node* const n )
+        -> node*&
+    {
+        auto const c = const_cast<node*>( detail::resolve_cell( n ) );
 
-    auto is_keyword( node const* const n )
-        -> bool;
+        return ( c->flags & cons_flag::e_cdr_next )
+            ? static_cast<compact_cons* const>( c )->car
+            : static_cast<cons* const>( c )->car;
+    }
 
-    auto is_native_function( node const* const n )
-        -> bool;
+    inline auto car( node const* const n )
+        -> node*
+    {
+        return car_slot( const_cast<node*>( n ) );
+    }
+
+    inline auto cdr( node const* const n )
+        -> node*
+    {
+        auto const c = detail::resolve_cell( n );
 
-    auto is_integer( node const* const n )
-        -> bool;
+        if ( c->flags & cons_flag::e_cdr_next ) {
+            return const_cast<compact_cons*>( static_cast<compact_cons const* const>( c ) + 1 );
+        }
 
-    auto is_float( node const* const n )
-        -> bool;
+        return static_cast<cons const* const>( c )->cdr;
+    }
 
-    auto is_callable( node const* const n )
-        -> bool;
+    // cdr of a compact cell cannot be written in place. the cell is forwarded to a new cons
+    template<typename GC>
+    auto set_cdr( GC& gc, node* const n, node* const v )
+        -> void
+    {
+        auto const c = const_cast<node*>( detail::resolve_cell( n ) );
 
+        if ( c->flags & cons_flag::e_cdr_next ) {
+            auto const replacement = gc.template make_object<cons>( car( c ), v );
+
+            c->flags |= cons_flag::e_forwarded;
+            static_cast<compact_cons* const>( c )->car = replacement;
+
+        } else {
+            static_cast<cons* const>( c )->cdr = v;
+        }
+    }
+
+
+    namespace detail
+    {
+        template<std::size_t N, typename GC, typename Iterator>
+        auto make_compact_run( GC& gc, Iterator first, node* const tail )
+            -> node*
+        {
+            auto const run = gc.template make_object<compact_run<N>>();
+            for( auto&& cell : run->cells ) {
+                cell.car = *first;
+                ++first;
+            }
+            run->last.car = *first;
+            run->last.cdr = tail;
+
+            return &run->cells[0];
+        }
+    } // namespace detail
+
+    // builds the list of [first, last) followed by tail as runs of compact cells.
+    // elements must be reachable from elsewhere while building
+    template<typename GC, typename Iterator>
+    auto make_list( GC& gc, Iterator const first, Iterator const last, node* const tail )
+        -> node*
+    {
+        static constexpr std::size_t max_run = 64;
+
+        // split into runs of power of 2 elements. e.g. 11 = 8 + 2 + 1
+        std::vector<std::size_t> sizes;
+        for( auto rest = static_cast<std::size_t>( std::distance( first, last ) ); rest > 0; ) {
+            std::size_t size = 1;
+            while( size * 2 <= rest && size < max_run ) size *= 2;
+
+            sizes.push_back( size );
+            rest -= size;
+        }
+
+        // build from the end, the list made so far is kept on the stack
+        node* volatile list = tail;
+        auto it = last;
+        for( auto s = sizes.crbegin(); s != sizes.crend(); ++s ) {
+            std::advance( it, -static_cast<std::ptrdiff_t>( *s ) );
+
+            switch( *s ) {
+            case 1:  list = gc.template make_object<cons>( *it, list ); break;
+            case 2:  list = detail::make_compact_run<2>( gc, it, list ); break;
+            case 4:  list = detail::make_compact_run<4>( gc, it, list ); break;
+            case 8:  list = detail::make_compact_run<8>( gc, it, list ); break;
+            case 16: list = detail::make_compact_run<16>( gc, it, list ); break;
+            case 32: list = detail::make_compact_run<32>( gc, it, list ); break;
+            default: list = detail::make_compact_run<max_run>( gc, it, list ); break;
+            }
+        }
+
+        return list;
+    }
+
+
+    inline auto to_bigint( node const* const n )
+        -> bigint
+    {
+        assert( is_integer( n ) );
+
+        if ( is_fixnum( n ) ) {
+            return bigint( fixnum_value( n ) );
+
+        } else {
+            return static_cast<bignum_value const* const>( n )->value;
+        }
+    }
 
 } // namespace yakkai
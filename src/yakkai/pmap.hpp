@@ -0,0 +1,332 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include "node.hpp"
+#include "hash_table.hpp"
+
+
+namespace yakkai
+{
+    // node of hash array mapped trie. nodes are never modified after they are built,
+    // so updated maps share all of nodes except ones on the path to the changed entry.
+    // each 5 bits of hashes select a slot. slots are pairs of ( key, value ) or ( nullptr, child ),
+    // and only used slots are stored in the order of bits in the bitmap.
+    struct hamt_node : public node
+    {
+        static constexpr std::size_t bits_per_level = 5;
+        static constexpr std::size_t hash_bits = 64;
+
+        hamt_node()
+            : node( node_type::e_hamt_node )
+            , bitmap( 0 )
+            , is_collision( false )
+        {}
+
+        inline auto pair_num() const
+            -> std::size_t
+        {
+            return slots.size() / 2;
+        }
+
+        std::uint32_t bitmap;
+        bool is_collision;          // all bits of hashes were used. pairs are searched linearly
+        std::vector<node*> slots;
+    };
+
+
+    //
+    struct pmap_value : public node
+    {
+        pmap_value( hamt_node* const r, std::size_t const s )
+            : node( node_type::e_pmap )
+            , root( r )
+            , size( s )
+        {}
+
+        // visits all of entries. used by gc and printer
+        template<typename F>
+        auto for_each( F const& f ) const
+            -> void
+        {
+            if ( root != nullptr ) for_each( root, f );
+        }
+
+        hamt_node* root;
+        std::size_t size;
+
+    private:
+        template<typename F>
+        static auto for_each( hamt_node const* const n, F const& f )
+            -> void
+        {
+            for( std::size_t i=0; i<n->slots.size(); i+=2 ) {
+                if ( n->slots[i] != nullptr ) {
+                    f( n->slots[i], n->slots[i+1] );
+                } else {
+                    for_each( static_cast<hamt_node const* const>( n->slots[i+1] ), f );
+                }
+            }
+        }
+    };
+
+
+    namespace detail
+    {
+        inline auto hamt_bit( std::size_t const hash, std::size_t const shift )
+            -> std::uint32_t
+        {
+            return static_cast<std::uint32_t>( 1 ) << ( ( hash >> shift ) & 0x1f );
+        }
+
+        inline auto hamt_index( hamt_node const* const n, std::uint32_t const bit )
+            -> std::size_t
+        {
+            return static_cast<std::size_t>( __builtin_popcount( n->bitmap & ( bit - 1 ) ) ) * 2;
+        }
+
+        template<typename GC>
+        auto hamt_copy( GC& gc, hamt_node const* const n )
+            -> hamt_node*
+        {
+            return gc.template make_object<hamt_node>( *n );
+        }
+
+        // a node which has the two pairs. their hashes are same up to shift
+        template<typename GC>
+        auto hamt_merge(
+            GC& gc,
+            std::size_t const shift,
+            node* const k0, node* const v0, std::size_t const h0,
+            node* const k1, node* const v1, std::size_t const h1
+            )
+            -> hamt_node*
+        {
+            if ( shift >= hamt_node::hash_bits ) {
+                auto const n = gc.template make_object<hamt_node>();
+                n->is_collision = true;
+                n->slots = { k0, v0, k1, v1 };
+                return n;
+            }
+
+            auto const b0 = hamt_bit( h0, shift );
+            auto const b1 = hamt_bit( h1, shift );
+            if ( b0 == b1 ) {
+                hamt_node* volatile const child = hamt_merge( gc, shift + hamt_node::bits_per_level, k0, v0, h0, k1, v1, h1 );
+
+                auto const n = gc.template make_object<hamt_node>();
+                n->bitmap = b0;
+                n->slots = { nullptr, child };
+                return n;
+            }
+
+            auto const n = gc.template make_object<hamt_node>();
+            n->bitmap = b0 | b1;
+            n->slots = b0 < b1
+                ? std::vector<node*>{ k0, v0, k1, v1 }
+                : std::vector<node*>{ k1, v1, k0, v0 };
+            return n;
+        }
+
+        template<typename GC>
+        auto hamt_assoc(
+            GC& gc,
+            hamt_node const* const n,
+            std::size_t const shift,
+            std::size_t const hash,
+            node* const key,
+            node* const value,
+            bool& added
+            )
+            -> hamt_node*
+        {
+            if ( n == nullptr ) {
+                added = true;
+
+                auto const r = gc.template make_object<hamt_node>();
+                r->bitmap = hamt_bit( hash, shift );
+                r->slots = { key, value };
+                return r;
+            }
+
+            if ( n->is_collision ) {
+                auto const r = hamt_copy( gc, n );
+                for( std::size_t i=0; i<r->slots.size(); i+=2 ) {
+                    if ( is_same_key( r->slots[i], key ) ) {
+                        r->slots[i+1] = value;
+                        return r;
+                    }
+                }
+
+                added = true;
+                r->slots.push_back( key );
+                r->slots.push_back( value );
+                return r;
+            }
+
+            auto const bit = hamt_bit( hash, shift );
+            auto const i = hamt_index( n, bit );
+
+            if ( ( n->bitmap & bit ) == 0 ) {
+                added = true;
+
+                auto const r = hamt_copy( gc, n );
+                r->bitmap |= bit;
+                r->slots.insert( r->slots.begin() + i, { key, value } );
+                return r;
+            }
+
+            auto const k = n->slots[i];
+            auto const v = n->slots[i+1];
+
+            node* volatile replaced = nullptr;
+            if ( k == nullptr ) {
+                // descend
+                replaced = hamt_assoc( gc, static_cast<hamt_node const* const>( v ), shift + hamt_node::bits_per_level, hash, key, value, added );
+
+            } else if ( is_same_key( k, key ) ) {
+                if ( v == value ) return const_cast<hamt_node*>( n );
+
+                auto const r = hamt_copy( gc, n );
+                r->slots[i+1] = value;
+                return r;
+
+            } else {
+                added = true;
+                replaced = hamt_merge( gc, shift + hamt_node::bits_per_level, k, v, hash_key( k ), key, value, hash );
+            }
+
+            auto const r = hamt_copy( gc, n );
+            r->slots[i] = nullptr;
+            r->slots[i+1] = replaced;
+            return r;
+        }
+
+        // returns nullptr if the node became empty
+        template<typename GC>
+        auto hamt_dissoc(
+            GC& gc,
+            hamt_node const* const n,
+            std::size_t const shift,
+            std::size_t const hash,
+            node const* const key,
+            bool& removed
+            )
+            -> hamt_node*
+        {
+            auto const without = [&]( std::size_t const i, std::uint32_t const bit ) -> hamt_node* {
+                removed = true;
+                if ( n->slots.size() == 2 ) return nullptr;
+
+                auto const r = hamt_copy( gc, n );
+                r->bitmap &= ~bit;
+                r->slots.erase( r->slots.begin() + i, r->slots.begin() + i + 2 );
+                return r;
+            };
+
+            if ( n->is_collision ) {
+                for( std::size_t i=0; i<n->slots.size(); i+=2 ) {
+                    if ( is_same_key( n->slots[i], key ) ) {
+                        return without( i, 0 );
+                    }
+                }
+                return const_cast<hamt_node*>( n );
+            }
+
+            auto const bit = hamt_bit( hash, shift );
+            if ( ( n->bitmap & bit ) == 0 ) {
+                return const_cast<hamt_node*>( n );
+            }
+
+            auto const i = hamt_index( n, bit );
+            auto const k = n->slots[i];
+            auto const v = n->slots[i+1];
+
+            if ( k != nullptr ) {
+                return is_same_key( k, key ) ? without( i, bit ) : const_cast<hamt_node*>( n );
+            }
+
+            // descend
+            auto const child = static_cast<hamt_node const* const>( v );
+            hamt_node* volatile const new_child = hamt_dissoc( gc, child, shift + hamt_node::bits_per_level, hash, key, removed );
+            if ( new_child == child ) {
+                return const_cast<hamt_node*>( n );
+            }
+            if ( new_child == nullptr ) {
+                return without( i, bit );
+            }
+
+            auto const r = hamt_copy( gc, n );
+            if ( new_child->pair_num() == 1 && new_child->slots[0] != nullptr ) {
+                // a single pair is pulled up, so that the trie stays minimal
+                r->slots[i] = new_child->slots[0];
+                r->slots[i+1] = new_child->slots[1];
+
+            } else {
+                r->slots[i+1] = new_child;
+            }
+            return r;
+        }
+    } // namespace detail
+
+
+    // returns nullptr if the key is not found
+    inline auto pmap_find( pmap_value const* const m, node const* const key )
+        -> node*
+    {
+        auto const hash = hash_key( key );
+
+        hamt_node const* n = m->root;
+        for( std::size_t shift = 0; n != nullptr; shift += hamt_node::bits_per_level ) {
+            if ( n->is_collision ) {
+                for( std::size_t i=0; i<n->slots.size(); i+=2 ) {
+                    if ( is_same_key( n->slots[i], key ) ) return n->slots[i+1];
+                }
+                return nullptr;
+            }
+
+            auto const bit = detail::hamt_bit( hash, shift );
+            if ( ( n->bitmap & bit ) == 0 ) return nullptr;
+
+            auto const i = detail::hamt_index( n, bit );
+            if ( n->slots[i] == nullptr ) {
+                n = static_cast<hamt_node const* const>( n->slots[i+1] );
+                continue;
+            }
+
+            return is_same_key( n->slots[i], key ) ? n->slots[i+1] : nullptr;
+        }
+
+        return nullptr;
+    }
+
+    // returns a new map, m is not changed
+    template<typename GC>
+    auto pmap_assoc( GC& gc, pmap_value const* const m, node* const key, node* const value )
+        -> pmap_value*
+    {
+        bool added = false;
+        hamt_node* volatile const root = detail::hamt_assoc( gc, m->root, 0, hash_key( key ), key, value, added );
+        if ( root == m->root ) return const_cast<pmap_value*>( m );
+
+        return gc.template make_object<pmap_value>( root, m->size + ( added ? 1 : 0 ) );
+    }
+
+    // returns a new map, m is not changed
+    template<typename GC>
+    auto pmap_dissoc( GC& gc, pmap_value const* const m, node const* const key )
+        -> pmap_value*
+    {
+        if ( m->root == nullptr ) return const_cast<pmap_value*>( m );
+
+        bool removed = false;
+        hamt_node* volatile const root = detail::hamt_dissoc( gc, m->root, 0, hash_key( key ), key, removed );
+        if ( !removed ) return const_cast<pmap_value*>( m );
+
+        return gc.template make_object<pmap_value>( root, m->size - 1 );
+    }
+
+} // namespace yakkai
@@ -1,9 +1,42 @@
 #include "static_context.hpp"
 
+#include <unordered_map>
+
 
 namespace yakkai
 {
+    namespace detail
+    {
+        template<typename T>
+        auto intern( std::string const& name )
+            -> T*
+        {
+            static std::unordered_map<std::string, std::unique_ptr<T>> table;
+
+            auto&& it = table.find( name );
+            if ( it != table.cend() ) return it->second.get();
+
+            auto p = new T( name );
+            table.emplace( name, std::unique_ptr<T>( p ) );
+
+            return p;
+        }
+    }
+
+
     //
     cons* const static_context::nil_object = new cons();
 
+    auto static_context::intern_symbol( std::string const& name )
+        -> symbol*
+    {
+        return detail::intern<symbol>( name );
+    }
+
+    auto static_context::intern_keyword( std::string const& name )
+        -> keyword*
+    {
+        return detail::intern<keyword>( name );
+    }
+
 } // namespace yakkai
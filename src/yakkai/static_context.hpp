@@ -11,6 +11,14 @@ namespace yakkai
     struct static_context
     {
         static cons* const nil_object;
+
+        // returns the unique symbol/keyword object for the name.
+        // interned objects live outside of the gc heap and are never collected
+        static auto intern_symbol( std::string const& name )
+            -> symbol*;
+
+        static auto intern_keyword( std::string const& name )
+            -> keyword*;
     };
 
 } // namespace yakkai
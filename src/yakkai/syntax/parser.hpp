@@ -1,10 +1,14 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <algorithm>
+#include <cctype>
 
 #include "../node.hpp"
 #include "../exception.hpp"
 #include "../static_context.hpp"
+#include "../hashcons.hpp"
 
 
 namespace yakkai
@@ -21,6 +25,24 @@ namespace yakkai
                 : gc_( gc )
             {}
 
+        public:
+            // string literals read from this buffer refer to it instead of copying their text.
+            // the buffer must be the one which iterators passed to parse_s_expression point to
+            auto set_source( std::shared_ptr<std::string const> const& source )
+                -> void
+            {
+                source_ = source;
+            }
+
+            // opt-in. literals and argument lists of quote are interned into the table, so that equal constants
+            // are shared and ( eq ( quote x ) ( quote x ) ) holds. the table must be swept by the owner of gc,
+            // e.g. machine::hashcons()
+            auto set_hash_consing( std::shared_ptr<hashcons_table<GC>> const& table )
+                -> void
+            {
+                hashcons_ = table;
+            }
+
         public:
             auto parse_s_expression( RangedIterator& rng_it )
                 -> node*
@@ -44,15 +66,12 @@ namespace yakkai
                         return static_context::nil_object;
                     }
 
-                    //
-                    cons* volatile const cell = gc_->template make_object<cons>( s, static_context::nil_object );
-                    // print2( cell );
-
                     skip_space( rng_it );
                     expect_not_eof( rng_it );
 
                     if ( *rng_it == '.' ) {
                         // cons cell
+                        cons* volatile const cell = gc_->template make_object<cons>( s, static_context::nil_object );
                         step_iterator( rng_it );
 
                         parse_s_expression( rng_it, cell );
@@ -60,18 +79,20 @@ namespace yakkai
 
                     } else {
                         // e_list
-                        cons* volatile last_cell = cell;
-                        while( cons* volatile const v = parse_s_expression_or_closer( rng_it, last_cell ) ) {
-                            // print2( v );
-                            // std::cout << (void*)&v << " -> " << (void*)v << std::endl;
-
-                            if ( is_nil( v ) ) break;
-                            last_cell = v;
+                        if ( hashcons_ != nullptr && s == static_context::intern_symbol( "quote" ) ) {
+                            // quote returns its argument list as it is, so the whole list is interned
+                            node* volatile const args = hashcons_->intern( parse_list_elements( rng_it, nullptr ) );
+                            return gc_->template make_object<cons>( s, args );
                         }
 
-                        return cell;
+                        return parse_list_elements( rng_it, s );
                     }
 
+                } else if ( *rng_it == '#' && is_vector_opener( rng_it ) ) {
+                    // #( ... )
+                    step_iterator( rng_it );
+                    return parse_vector( rng_it );
+
                 } else if ( is_enable_closer && *rng_it == ')' ) {
                     return parse_closer_s_expression( rng_it, nullptr );
 
@@ -80,6 +101,10 @@ namespace yakkai
                     node* volatile a = parse_atom( rng_it );
                     assert( a != nullptr );
 
+                    if ( hashcons_ != nullptr ) {
+                        a = hashcons_->intern( a );
+                    }
+
                     if ( !parse_token_separate( rng_it ) ) {
                         throw "parse error";
                     }
@@ -88,47 +113,84 @@ namespace yakkai
                 }
             }
 
-            auto parse_s_expression( RangedIterator& rng_it, cons* outer_cell, bool const is_enable_closer )
-                -> cons*
+            auto parse_s_expression_or_closer( RangedIterator& rng_it )
+                -> node*
             {
-                node* volatile const s = parse_s_expression( rng_it, is_enable_closer );
-
-                //
-                if ( s == nullptr ) {
-                    outer_cell->cdr = static_context::nil_object;
-                    return static_context::nil_object;
-
-                } else {
-                    cons* volatile inner_cell = gc_->template make_object<cons>( s, static_context::nil_object );
-
-                    assert( outer_cell != nullptr );
-                    outer_cell->cdr = inner_cell;
+                return parse_s_expression( rng_it, true );
+            }
 
-                    return inner_cell;  // NOTE:
+            auto parse_closer_s_expression( RangedIterator& rng_it, node* n = nullptr )
+                -> node*
+            {
+                if ( *rng_it != ')' ) {
+                    assert( false );
                 }
+                step_iterator( rng_it );
+
+                return n;
             }
 
-            auto parse_s_expression_or_closer( RangedIterator& rng_it )
+            // read lists are rarely modified, so they are built as cdr-coded runs directly.
+            // elements are held in a chunk on the stack (so that the collector finds them) while the rest
+            // of the list is read recursively, then runs of the chunk are put in front of the rest
+            auto parse_list_elements( RangedIterator& rng_it, node* const head )
                 -> node*
             {
-                return parse_s_expression( rng_it, true );
+                static constexpr std::size_t chunk_size = 64;
+
+                node* volatile chunk[chunk_size];
+                std::size_t size = 0;
+                if ( head != nullptr ) {
+                    chunk[size++] = head;
+                }
+
+                bool is_closed = false;
+                while( size < chunk_size ) {
+                    node* volatile const e = parse_s_expression_or_closer( rng_it );
+                    if ( e == nullptr ) {
+                        is_closed = true;
+                        break;
+                    }
+
+                    chunk[size++] = e;
+                }
+
+                node* volatile const tail = is_closed
+                    ? static_context::nil_object
+                    : parse_list_elements( rng_it, nullptr );
+
+                return make_list( *gc_, chunk, chunk + size, tail );
             }
 
-            auto parse_s_expression_or_closer( RangedIterator& rng_it, cons* outer_cell )
-                -> cons*
+            auto is_vector_opener( RangedIterator rng_it ) const
+                -> bool
             {
-                return parse_s_expression( rng_it, outer_cell, true );
+                step_iterator( rng_it );
+                return !is_eof( rng_it ) && *rng_it == '(';
             }
 
-            auto parse_closer_s_expression( RangedIterator& rng_it, node* n = nullptr )
+            auto parse_vector( RangedIterator& rng_it )
                 -> node*
             {
-                if ( *rng_it != ')' ) {
-                    assert( false );
+                // read elements as a list (it is kept on the stack while allocating), then copy them
+                node* volatile const elements = parse_s_expression( rng_it, false );
+
+                std::size_t size = 0;
+                for( node const* l = elements; !is_nil( l ); l = cdr( l ) ) {
+                    assert( is_list( l ) );
+                    ++size;
                 }
-                step_iterator( rng_it );
 
-                return n;
+                auto v = gc_->template make_object<vector_value>( size, static_context::nil_object );
+
+                node const* l = elements;
+                for( auto&& e : v->elements ) {
+                    auto&& c = static_cast<cons const* const>( l );
+                    e = car( c );
+                    l = cdr( c );
+                }
+
+                return v;
             }
 
             auto parse_token_separate( RangedIterator& rng_it )
@@ -141,7 +203,10 @@ namespace yakkai
             auto parse_atom( RangedIterator& rng_it )
                 -> node*
             {
-                if ( auto k = parse_keyword( rng_it ) ) {
+                if ( auto str = parse_string( rng_it ) ) {
+                    return str;
+
+                } else if ( auto k = parse_keyword( rng_it ) ) {
                     return k;
 
                 } else if ( auto s = parse_symbol( rng_it ) ) {
@@ -158,7 +223,10 @@ namespace yakkai
             auto parse_numbers( RangedIterator& rng_it )
                 -> node*
             {
-                if ( auto i = parse_integer( rng_it ) ) {
+                if ( auto r = parse_ratio( rng_it ) ) {
+                    return r;
+
+                } else if ( auto i = parse_integer( rng_it ) ) {
                     return i;
 
                 } else if ( auto f = parse_float( rng_it ) ) {
@@ -170,6 +238,54 @@ namespace yakkai
             }
 
         public:
+            // "..." with escapes \" \\ \n \t
+            auto parse_string( RangedIterator& rng_it )
+                -> node*
+            {
+                if ( *rng_it != '"' ) {
+                    return nullptr;
+                }
+                step_iterator( rng_it );
+
+                RangedIterator const begin = rng_it;
+                bool has_escape = false;
+
+                expect_not_eof( rng_it );
+                while( *rng_it != '"' ) {
+                    if ( *rng_it == '\\' ) {
+                        has_escape = true;
+                        step_iterator( rng_it );
+                    }
+                    step_iterator( rng_it );
+                    expect_not_eof( rng_it );
+                }
+                RangedIterator const end = rng_it;
+                step_iterator( rng_it );
+
+                if ( !has_escape ) {
+                    if ( auto&& slice = make_source_slice( begin, end ) ) {
+                        return slice;
+                    }
+                }
+
+                std::string text;
+                for( auto it = begin; it != end; ++it ) {
+                    if ( *it == '\\' ) {
+                        ++it;
+                        switch( *it ) {
+                        case 'n': text += '\n'; break;
+                        case 't': text += '\t'; break;
+                        default: text += *it; break;
+                        }
+
+                    } else {
+                        text += *it;
+                    }
+                }
+
+                return gc_->template make_object<string_value>( std::move( text ) );
+            }
+
             auto parse_keyword( RangedIterator& rng_it )
                 -> node*
             {
@@ -186,7 +302,7 @@ namespace yakkai
                         step_iterator( rng_it );
                     }
 
-                    return gc_->template make_object<keyword>( std::string( begin.it(), rng_it.it() ) );
+                    return static_context::intern_keyword( std::string( begin.it(), rng_it.it() ) );
 
                 } else {
                     rng_it = begin;
@@ -202,15 +318,17 @@ namespace yakkai
                 if ( ( *rng_it >= 'A' && *rng_it <= 'Z' ) || ( *rng_it >= 'a' && *rng_it <= 'z' ) ) {
                     step_iterator( rng_it );
 
+                    // hyphens are allowed after the first character. e.g. make-vector
                     while( !is_eof( rng_it )
                            && ( ( *rng_it >= 'A' && *rng_it <= 'Z' )
                                 || ( *rng_it >= 'a' && *rng_it <= 'z' )
-                                || ( *rng_it >= '0' && *rng_it <= '9' ) )
+                                || ( *rng_it >= '0' && *rng_it <= '9' )
+                                || *rng_it == '-' )
                         ) {
                         step_iterator( rng_it );
                     }
 
-                    return gc_->template make_object<symbol>( std::string( begin.it(), rng_it.it() ) );
+                    return static_context::intern_symbol( std::string( begin.it(), rng_it.it() ) );
 
                 } else {
                     rng_it = begin;
@@ -224,7 +342,7 @@ namespace yakkai
             {
                 RangedIterator begin = rng_it;
                 int radix = 10;
-                long long number = 0;
+                std::string digits;
 
                 if ( *rng_it == '#' ) {
                     step_iterator( rng_it );
@@ -259,21 +377,54 @@ namespace yakkai
                         rng_it = begin;
                         return nullptr;
                     }
-                    number = std::stoll( std::string( base_it.it(), rng_it.it() ), nullptr, radix );
+                    digits = take_digits( base_it, rng_it );
                 }
 
                 //
-                if ( !is_eof( rng_it ) && ( *rng_it == '.' || *rng_it == 'e' || *rng_it == 'E' ) ) {
+                if ( !is_eof( rng_it ) && ( *rng_it == '.' || *rng_it == 'e' || *rng_it == 'E' || *rng_it == '/' ) ) {
                     rng_it = begin;
                     return nullptr;
                 }
 
                 skip_space( rng_it );
 
-                return gc_->template make_object<integer_value>( number );
+                // short numbers always fit in long long
+                if ( digits.size() < 18 ) {
+                    return make_integer( *gc_, std::stoll( digits, nullptr, radix ) );
+                }
+
+                return make_integer( *gc_, bigint::from_string( digits, radix ) );
             }
 
 
+            // (+|-)? digit+ / digit+
+            auto parse_ratio( RangedIterator& rng_it )
+                -> node*
+            {
+                RangedIterator begin = rng_it;
+
+                if ( !parse_digit_with_sign( rng_it ) || is_eof( rng_it ) || *rng_it != '/' ) {
+                    rng_it = begin;
+                    return nullptr;
+                }
+                auto const numerator = take_digits( begin, rng_it );
+                step_iterator( rng_it );
+
+                RangedIterator denominator_it = rng_it;
+                if ( !parse_digit( rng_it ) ) {
+                    rng_it = begin;
+                    return nullptr;
+                }
+                auto const denominator = bigint::from_string( take_digits( denominator_it, rng_it ) );
+                if ( denominator.is_zero() ) {
+                    throw "parse error";
+                }
+
+                skip_space( rng_it );
+
+                return make_ratio( *gc_, bigint::from_string( numerator ), denominator );
+            }
+
             // 0.0
             // .0
             // .0e10
@@ -341,7 +492,7 @@ namespace yakkai
                         }
                     }
 
-                    return gc_->template make_object<float_value>( number, exp );
+                    return gc_->template make_object<float_value>( std::stod( number + "e" + ( exp.empty() ? "0" : exp ) ) );
 
                 } else {
                     rng_it = begin;
@@ -349,6 +500,16 @@ namespace yakkai
                 }
             }
 
+            // digits between begin and end without spaces
+            auto take_digits( RangedIterator const& begin, RangedIterator const& end ) const
+                -> std::string
+            {
+                std::string digits( begin.it_, end.it_ );
+                digits.erase( std::remove_if( digits.begin(), digits.end(), []( char const c ) { return std::isspace( c ); } ), digits.end() );
+
+                return digits;
+            }
+
             auto parse_digit( RangedIterator& rng_it )
                 -> bool
             {
@@ -395,6 +556,28 @@ namespace yakkai
                 }
             }
 
+        private:
+            auto make_source_slice( RangedIterator begin, RangedIterator end ) const
+                -> node*
+            {
+                if ( source_ == nullptr || begin == end ) {
+                    return nullptr;
+                }
+
+                auto const p = std::addressof( *begin );
+                auto const length = static_cast<std::size_t>( std::distance( begin.it(), end.it() ) );
+                if ( p < source_->data() || p + length > source_->data() + source_->size() ) {
+                    // iterators do not point to the source buffer
+                    return nullptr;
+                }
+
+                return gc_->template make_object<string_value>(
+                    source_,
+                    static_cast<std::size_t>( p - source_->data() ),
+                    length
+                    );
+            }
+
         private:
             auto skip_space( RangedIterator& rng_it )
                 -> void
@@ -434,6 +617,8 @@ namespace yakkai
 
         private:
             std::shared_ptr<GC> gc_;
+            std::shared_ptr<std::string const> source_;
+            std::shared_ptr<hashcons_table<GC>> hashcons_;
         };
 
     } // namespace syntax
@@ -0,0 +1,605 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <cstdint>
+#include <cassert>
+
+
+namespace yakkai
+{
+    // arbitrary precision integer. sign and magnitude of 32bit limbs (little endian)
+    class bigint
+    {
+    public:
+        using limb_type = std::uint32_t;
+        using double_limb_type = std::uint64_t;
+        using magnitude_type = std::vector<limb_type>;
+
+        static constexpr std::size_t limb_bits = 32;
+        static constexpr std::size_t karatsuba_threshold = 32;    // limbs
+
+    public:
+        bigint()
+            : negative_( false )
+        {}
+
+        bigint( long long const v )
+            : negative_( v < 0 )
+        {
+            // avoid overflow of -LLONG_MIN
+            auto m = negative_
+                ? static_cast<double_limb_type>( -( v + 1 ) ) + 1
+                : static_cast<double_limb_type>( v );
+            while( m != 0 ) {
+                limbs_.push_back( static_cast<limb_type>( m ) );
+                m >>= limb_bits;
+            }
+        }
+
+    public:
+        // [+-]?[0-9a-zA-Z]+
+        static auto from_string( std::string const& s, int const radix = 10 )
+            -> bigint
+        {
+            assert( radix >= 2 && radix <= 36 );
+
+            bigint r;
+            std::size_t i = 0;
+            bool negative = false;
+            if ( i < s.size() && ( s[i] == '+' || s[i] == '-' ) ) {
+                negative = s[i] == '-';
+                ++i;
+            }
+
+            if ( i == s.size() ) {
+                throw std::invalid_argument( "bigint: no digits" );
+            }
+
+            for( ; i<s.size(); ++i ) {
+                auto const d = digit_value( s[i] );
+                if ( d < 0 || d >= radix ) {
+                    throw std::invalid_argument( "bigint: invalid digit" );
+                }
+
+                mul_add_small( r.limbs_, static_cast<limb_type>( radix ), static_cast<limb_type>( d ) );
+            }
+
+            r.negative_ = negative;
+            r.normalize();
+
+            return r;
+        }
+
+        auto to_string( int const radix = 10 ) const
+            -> std::string
+        {
+            assert( radix >= 2 && radix <= 36 );
+
+            if ( is_zero() ) return "0";
+
+            // divide by the largest power of radix which fits in a limb
+            limb_type chunk = radix;
+            std::size_t chunk_digits = 1;
+            while( static_cast<double_limb_type>( chunk ) * radix <= std::numeric_limits<limb_type>::max() ) {
+                chunk *= radix;
+                ++chunk_digits;
+            }
+
+            std::string s;
+            magnitude_type m = limbs_;
+            while( !m.empty() ) {
+                auto rem = div_small( m, chunk );
+                for( std::size_t i=0; i<chunk_digits && ( rem != 0 || !m.empty() ); ++i ) {
+                    s += "0123456789abcdefghijklmnopqrstuvwxyz"[rem % radix];
+                    rem /= radix;
+                }
+            }
+
+            if ( negative_ ) s += '-';
+            std::reverse( s.begin(), s.end() );
+
+            return s;
+        }
+
+    public:
+        inline auto is_zero() const
+            -> bool
+        {
+            return limbs_.empty();
+        }
+
+        inline auto is_negative() const
+            -> bool
+        {
+            return negative_;
+        }
+
+        inline auto limbs() const
+            -> magnitude_type const&
+        {
+            return limbs_;
+        }
+
+        auto fits_long_long() const
+            -> bool
+        {
+            if ( limbs_.size() > 2 ) return false;
+
+            auto const m = magnitude_to_u64();
+            auto const limit = static_cast<double_limb_type>( std::numeric_limits<long long>::max() );
+
+            return negative_ ? m <= limit + 1 : m <= limit;
+        }
+
+        auto to_long_long() const
+            -> long long
+        {
+            assert( fits_long_long() );
+
+            auto const m = magnitude_to_u64();
+            if ( negative_ ) {
+                return -static_cast<long long>( m - 1 ) - 1;
+            } else {
+                return static_cast<long long>( m );
+            }
+        }
+
+        auto to_double() const
+            -> double
+        {
+            double d = 0.0;
+            for( auto it = limbs_.crbegin(); it != limbs_.crend(); ++it ) {
+                d = d * 4294967296.0 + *it;
+            }
+
+            return negative_ ? -d : d;
+        }
+
+    public:
+        auto operator-() const
+            -> bigint
+        {
+            bigint r = *this;
+            if ( !r.is_zero() ) r.negative_ = !r.negative_;
+
+            return r;
+        }
+
+        friend auto operator+( bigint const& lhs, bigint const& rhs )
+            -> bigint
+        {
+            if ( lhs.negative_ == rhs.negative_ ) {
+                return bigint( lhs.negative_, add_magnitude( lhs.limbs_, rhs.limbs_ ) );
+            }
+
+            // different signs
+            auto const c = compare_magnitude( lhs.limbs_, rhs.limbs_ );
+            if ( c == 0 ) return bigint();
+
+            return c > 0
+                ? bigint( lhs.negative_, sub_magnitude( lhs.limbs_, rhs.limbs_ ) )
+                : bigint( rhs.negative_, sub_magnitude( rhs.limbs_, lhs.limbs_ ) );
+        }
+
+        friend auto operator-( bigint const& lhs, bigint const& rhs )
+            -> bigint
+        {
+            return lhs + -rhs;
+        }
+
+        friend auto operator*( bigint const& lhs, bigint const& rhs )
+            -> bigint
+        {
+            return bigint( lhs.negative_ != rhs.negative_, mul_magnitude( lhs.limbs_, rhs.limbs_ ) );
+        }
+
+        // truncated division
+        friend auto operator/( bigint const& lhs, bigint const& rhs )
+            -> bigint
+        {
+            bigint q, r;
+            divmod( lhs, rhs, q, r );
+
+            return q;
+        }
+
+        friend auto operator%( bigint const& lhs, bigint const& rhs )
+            -> bigint
+        {
+            bigint q, r;
+            divmod( lhs, rhs, q, r );
+
+            return r;
+        }
+
+        // q = trunc( lhs / rhs ), r = lhs - q * rhs
+        static auto divmod( bigint const& lhs, bigint const& rhs, bigint& q, bigint& r )
+            -> void
+        {
+            if ( rhs.is_zero() ) {
+                throw std::domain_error( "bigint: division by zero" );
+            }
+
+            magnitude_type qm, rm;
+            divmod_magnitude( lhs.limbs_, rhs.limbs_, qm, rm );
+
+            q = bigint( lhs.negative_ != rhs.negative_, std::move( qm ) );
+            r = bigint( lhs.negative_, std::move( rm ) );
+        }
+
+        // non negative gcd by euclidean algorithm
+        static auto gcd( bigint m, bigint n )
+            -> bigint
+        {
+            m.negative_ = false;
+            n.negative_ = false;
+
+            while( !n.is_zero() ) {
+                auto r = m % n;
+                m = std::move( n );
+                n = std::move( r );
+            }
+
+            return m;
+        }
+
+    public:
+        friend auto compare( bigint const& lhs, bigint const& rhs )
+            -> int
+        {
+            if ( lhs.negative_ != rhs.negative_ ) {
+                return lhs.negative_ ? -1 : 1;
+            }
+
+            auto const c = compare_magnitude( lhs.limbs_, rhs.limbs_ );
+            return lhs.negative_ ? -c : c;
+        }
+
+        friend auto operator==( bigint const& lhs, bigint const& rhs )
+            -> bool
+        {
+            return lhs.negative_ == rhs.negative_ && lhs.limbs_ == rhs.limbs_;
+        }
+
+        friend auto operator!=( bigint const& lhs, bigint const& rhs )
+            -> bool
+        {
+            return !( lhs == rhs );
+        }
+
+        friend auto operator<( bigint const& lhs, bigint const& rhs )
+            -> bool
+        {
+            return compare( lhs, rhs ) < 0;
+        }
+
+    private:
+        bigint( bool const negative, magnitude_type&& m )
+            : negative_( negative )
+            , limbs_( std::move( m ) )
+        {
+            normalize();
+        }
+
+        auto normalize()
+            -> void
+        {
+            trim( limbs_ );
+            if ( limbs_.empty() ) negative_ = false;
+        }
+
+        auto magnitude_to_u64() const
+            -> double_limb_type
+        {
+            double_limb_type m = 0;
+            for( std::size_t i=0; i<limbs_.size() && i<2; ++i ) {
+                m |= static_cast<double_limb_type>( limbs_[i] ) << ( limb_bits * i );
+            }
+
+            return m;
+        }
+
+        static auto digit_value( char const c )
+            -> int
+        {
+            if ( c >= '0' && c <= '9' ) return c - '0';
+            if ( c >= 'a' && c <= 'z' ) return c - 'a' + 10;
+            if ( c >= 'A' && c <= 'Z' ) return c - 'A' + 10;
+
+            return -1;
+        }
+
+    private:
+        static auto trim( magnitude_type& m )
+            -> void
+        {
+            while( !m.empty() && m.back() == 0 ) m.pop_back();
+        }
+
+        static auto compare_magnitude( magnitude_type const& a, magnitude_type const& b )
+            -> int
+        {
+            if ( a.size() != b.size() ) {
+                return a.size() < b.size() ? -1 : 1;
+            }
+
+            for( std::size_t i=a.size(); i>0; --i ) {
+                if ( a[i-1] != b[i-1] ) {
+                    return a[i-1] < b[i-1] ? -1 : 1;
+                }
+            }
+
+            return 0;
+        }
+
+        static auto add_magnitude( magnitude_type const& a, magnitude_type const& b )
+            -> magnitude_type
+        {
+            magnitude_type r = a.size() < b.size() ? b : a;
+            add_into( r, a.size() < b.size() ? a : b, 0 );
+
+            return r;
+        }
+
+        // r += x << ( offset limbs )
+        static auto add_into( magnitude_type& r, magnitude_type const& x, std::size_t const offset )
+            -> void
+        {
+            if ( r.size() < x.size() + offset ) r.resize( x.size() + offset, 0 );
+
+            double_limb_type carry = 0;
+            std::size_t i = 0;
+            for( ; i<x.size(); ++i ) {
+                auto const t = static_cast<double_limb_type>( r[i + offset] ) + x[i] + carry;
+                r[i + offset] = static_cast<limb_type>( t );
+                carry = t >> limb_bits;
+            }
+
+            for( i += offset; carry != 0; ++i ) {
+                if ( i == r.size() ) r.push_back( 0 );
+
+                auto const t = static_cast<double_limb_type>( r[i] ) + carry;
+                r[i] = static_cast<limb_type>( t );
+                carry = t >> limb_bits;
+            }
+        }
+
+        // a - b ( a >= b )
+        static auto sub_magnitude( magnitude_type const& a, magnitude_type const& b )
+            -> magnitude_type
+        {
+            magnitude_type r = a;
+            sub_into( r, b );
+
+            return r;
+        }
+
+        // r -= x ( r >= x )
+        static auto sub_into( magnitude_type& r, magnitude_type const& x )
+            -> void
+        {
+            assert( compare_magnitude( r, x ) >= 0 );
+
+            std::int64_t borrow = 0;
+            std::size_t i = 0;
+            for( ; i<x.size(); ++i ) {
+                auto const t = static_cast<std::int64_t>( r[i] ) - x[i] - borrow;
+                r[i] = static_cast<limb_type>( t );
+                borrow = t < 0 ? 1 : 0;
+            }
+
+            for( ; borrow != 0 && i<r.size(); ++i ) {
+                auto const t = static_cast<std::int64_t>( r[i] ) - borrow;
+                r[i] = static_cast<limb_type>( t );
+                borrow = t < 0 ? 1 : 0;
+            }
+            assert( borrow == 0 );
+
+            trim( r );
+        }
+
+        static auto mul_magnitude( magnitude_type const& a, magnitude_type const& b )
+            -> magnitude_type
+        {
+            if ( a.empty() || b.empty() ) return magnitude_type();
+
+            if ( std::min( a.size(), b.size() ) < karatsuba_threshold ) {
+                return mul_schoolbook( a, b );
+            }
+
+            return mul_karatsuba( a, b );
+        }
+
+        static auto mul_schoolbook( magnitude_type const& a, magnitude_type const& b )
+            -> magnitude_type
+        {
+            magnitude_type r( a.size() + b.size(), 0 );
+
+            for( std::size_t i=0; i<a.size(); ++i ) {
+                double_limb_type carry = 0;
+                for( std::size_t j=0; j<b.size(); ++j ) {
+                    auto const t = static_cast<double_limb_type>( a[i] ) * b[j] + r[i + j] + carry;
+                    r[i + j] = static_cast<limb_type>( t );
+                    carry = t >> limb_bits;
+                }
+                r[i + b.size()] = static_cast<limb_type>( carry );
+            }
+            trim( r );
+
+            return r;
+        }
+
+        // a * b = z2 * B^2m + ( ( a0 + a1 )( b0 + b1 ) - z2 - z0 ) * B^m + z0
+        static auto mul_karatsuba( magnitude_type const& a, magnitude_type const& b )
+            -> magnitude_type
+        {
+            auto const m = std::max( a.size(), b.size() ) / 2;
+
+            auto const split = []( magnitude_type const& x, std::size_t const m, magnitude_type& low, magnitude_type& high ) {
+                if ( x.size() <= m ) {
+                    low = x;
+                    high.clear();
+                } else {
+                    low.assign( x.begin(), x.begin() + m );
+                    high.assign( x.begin() + m, x.end() );
+                }
+                trim( low );
+            };
+
+            magnitude_type a0, a1, b0, b1;
+            split( a, m, a0, a1 );
+            split( b, m, b0, b1 );
+
+            auto const z0 = mul_magnitude( a0, b0 );
+            auto const z2 = mul_magnitude( a1, b1 );
+            auto z1 = mul_magnitude( add_magnitude( a0, a1 ), add_magnitude( b0, b1 ) );
+            sub_into( z1, z0 );
+            sub_into( z1, z2 );
+
+            magnitude_type r = z0;
+            add_into( r, z1, m );
+            add_into( r, z2, m * 2 );
+            trim( r );
+
+            return r;
+        }
+
+        // m = m * k + a
+        static auto mul_add_small( magnitude_type& m, limb_type const k, limb_type const a )
+            -> void
+        {
+            double_limb_type carry = a;
+            for( auto&& l : m ) {
+                auto const t = static_cast<double_limb_type>( l ) * k + carry;
+                l = static_cast<limb_type>( t );
+                carry = t >> limb_bits;
+            }
+            if ( carry != 0 ) m.push_back( static_cast<limb_type>( carry ) );
+        }
+
+        // m = m / d, returns remainder
+        static auto div_small( magnitude_type& m, limb_type const d )
+            -> limb_type
+        {
+            double_limb_type rem = 0;
+            for( std::size_t i=m.size(); i>0; --i ) {
+                auto const t = ( rem << limb_bits ) | m[i-1];
+                m[i-1] = static_cast<limb_type>( t / d );
+                rem = t % d;
+            }
+            trim( m );
+
+            return static_cast<limb_type>( rem );
+        }
+
+        static auto count_leading_zeros( limb_type x )
+            -> unsigned
+        {
+            unsigned n = 0;
+            if ( x == 0 ) return limb_bits;
+            while( ( x & 0x80000000u ) == 0 ) {
+                x <<= 1;
+                ++n;
+            }
+
+            return n;
+        }
+
+        // Knuth, TAOCP vol.2 4.3.1 algorithm D
+        static auto divmod_magnitude( magnitude_type const& u, magnitude_type const& v, magnitude_type& q, magnitude_type& r )
+            -> void
+        {
+            assert( !v.empty() );
+
+            if ( compare_magnitude( u, v ) < 0 ) {
+                q.clear();
+                r = u;
+                return;
+            }
+
+            if ( v.size() == 1 ) {
+                q = u;
+                auto const rem = div_small( q, v[0] );
+                r.clear();
+                if ( rem != 0 ) r.push_back( rem );
+                return;
+            }
+
+            auto const n = v.size();
+            auto const m = u.size() - n;
+            auto const s = count_leading_zeros( v.back() );
+
+            // normalize so that the top bit of the divisor is set
+            magnitude_type vn( n ), un( u.size() + 1 );
+            for( std::size_t i=n-1; i>0; --i ) {
+                vn[i] = ( v[i] << s ) | ( s == 0 ? 0 : static_cast<limb_type>( static_cast<double_limb_type>( v[i-1] ) >> ( limb_bits - s ) ) );
+            }
+            vn[0] = v[0] << s;
+
+            un[u.size()] = s == 0 ? 0 : static_cast<limb_type>( static_cast<double_limb_type>( u.back() ) >> ( limb_bits - s ) );
+            for( std::size_t i=u.size()-1; i>0; --i ) {
+                un[i] = ( u[i] << s ) | ( s == 0 ? 0 : static_cast<limb_type>( static_cast<double_limb_type>( u[i-1] ) >> ( limb_bits - s ) ) );
+            }
+            un[0] = u[0] << s;
+
+            double_limb_type const base = static_cast<double_limb_type>( 1 ) << limb_bits;
+
+            q.assign( m + 1, 0 );
+            for( std::size_t jj=m+1; jj>0; --jj ) {
+                auto const j = jj - 1;
+
+                // estimate
+                auto const num = ( static_cast<double_limb_type>( un[j+n] ) << limb_bits ) | un[j+n-1];
+                auto qhat = num / vn[n-1];
+                auto rhat = num % vn[n-1];
+                while( qhat >= base || qhat * vn[n-2] > ( ( rhat << limb_bits ) | un[j+n-2] ) ) {
+                    --qhat;
+                    rhat += vn[n-1];
+                    if ( rhat >= base ) break;
+                }
+
+                // multiply and subtract
+                std::int64_t k = 0;
+                std::int64_t t = 0;
+                for( std::size_t i=0; i<n; ++i ) {
+                    auto const p = qhat * vn[i];
+                    t = static_cast<std::int64_t>( un[i+j] ) - k - static_cast<std::int64_t>( p & 0xffffffffu );
+                    un[i+j] = static_cast<limb_type>( t );
+                    k = static_cast<std::int64_t>( p >> limb_bits ) - ( t >> limb_bits );
+                }
+                t = static_cast<std::int64_t>( un[j+n] ) - k;
+                un[j+n] = static_cast<limb_type>( t );
+
+                q[j] = static_cast<limb_type>( qhat );
+                if ( t < 0 ) {
+                    // add back
+                    --q[j];
+                    double_limb_type c = 0;
+                    for( std::size_t i=0; i<n; ++i ) {
+                        auto const w = static_cast<double_limb_type>( un[i+j] ) + vn[i] + c;
+                        un[i+j] = static_cast<limb_type>( w );
+                        c = w >> limb_bits;
+                    }
+                    un[j+n] = static_cast<limb_type>( un[j+n] + c );
+                }
+            }
+            trim( q );
+
+            // unnormalize remainder
+            r.assign( n, 0 );
+            for( std::size_t i=0; i<n; ++i ) {
+                r[i] = ( un[i] >> s ) | ( s == 0 ? 0 : static_cast<limb_type>( static_cast<double_limb_type>( un[i+1] ) << ( limb_bits - s ) ) );
+            }
+            trim( r );
+        }
+
+    private:
+        bool negative_;
+        magnitude_type limbs_;
+    };
+
+} // namespace yakkai
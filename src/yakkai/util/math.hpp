@@ -1,23 +1,38 @@
 #pragma once
 
 #include <utility>
+#include <limits>
 
 
 namespace yakkai
 {
+    // binary gcd (Stein's algorithm) for non negative integers
     template<typename I>
     auto gcd( I m, I n )
         -> I
     {
-        if ( n < m ) std::swap( m, n );
+        if ( m == 0 ) return n;
+        if ( n == 0 ) return m;
 
-        I r;
-        while( n != 0 ) {
-            r = m % n;
-            m = n;
-            n = r;
+        // common factors of 2
+        unsigned shift = 0;
+        while( ( ( m | n ) & 1 ) == 0 ) {
+            m >>= 1;
+            n >>= 1;
+            ++shift;
         }
-        return m;
+
+        while( ( m & 1 ) == 0 ) m >>= 1;
+
+        // m is always odd from here
+        do {
+            while( ( n & 1 ) == 0 ) n >>= 1;
+
+            if ( m > n ) std::swap( m, n );
+            n -= m;
+        } while( n != 0 );
+
+        return m << shift;
     }
 
     template<typename I>
@@ -26,4 +41,24 @@ namespace yakkai
     {
         return ( m * n ) / gcd( m, n );
     }
+
+    // r = m * n. returns false if overflowed
+    inline auto checked_multiply( long long const m, long long const n, long long& r )
+        -> bool
+    {
+#if defined(__GNUC__)
+        return !__builtin_mul_overflow( m, n, &r );
+#else
+        using limits = std::numeric_limits<long long>;
+
+        bool const overflowed
+            = m > 0
+            ? ( n > 0 ? m > limits::max() / n : n < limits::min() / m )
+            : ( n > 0 ? m < limits::min() / n : ( m != 0 && n < limits::max() / m ) );
+        if ( overflowed ) return false;
+
+        r = m * n;
+        return true;
+#endif
+    }
 } // namespace yakkai
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__)
+# include <immintrin.h>
+#endif
+
+
+namespace yakkai
+{
+    // reductions and elementwise operations over unboxed arrays.
+    // SSE2/AVX paths are selected at compile time. the tails are processed by scalar loops
+    namespace kernel
+    {
+        //
+        // double
+        //
+        inline auto sum( double const* const a, std::size_t const n )
+            -> double
+        {
+            std::size_t i = 0;
+            double r = 0.0;
+#if defined(__AVX__)
+            __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+            for( ; i+8<=n; i+=8 ) {
+                acc0 = _mm256_add_pd( acc0, _mm256_loadu_pd( a + i ) );
+                acc1 = _mm256_add_pd( acc1, _mm256_loadu_pd( a + i + 4 ) );
+            }
+            alignas( 32 ) double lanes[4];
+            _mm256_store_pd( lanes, _mm256_add_pd( acc0, acc1 ) );
+            r = ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] );
+#elif defined(__SSE2__)
+            __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+            for( ; i+4<=n; i+=4 ) {
+                acc0 = _mm_add_pd( acc0, _mm_loadu_pd( a + i ) );
+                acc1 = _mm_add_pd( acc1, _mm_loadu_pd( a + i + 2 ) );
+            }
+            alignas( 16 ) double lanes[2];
+            _mm_store_pd( lanes, _mm_add_pd( acc0, acc1 ) );
+            r = lanes[0] + lanes[1];
+#endif
+            for( ; i<n; ++i ) r += a[i];
+
+            return r;
+        }
+
+        inline auto dot( double const* const a, double const* const b, std::size_t const n )
+            -> double
+        {
+            std::size_t i = 0;
+            double r = 0.0;
+#if defined(__AVX__)
+            __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+            for( ; i+8<=n; i+=8 ) {
+                acc0 = _mm256_add_pd( acc0, _mm256_mul_pd( _mm256_loadu_pd( a + i ), _mm256_loadu_pd( b + i ) ) );
+                acc1 = _mm256_add_pd( acc1, _mm256_mul_pd( _mm256_loadu_pd( a + i + 4 ), _mm256_loadu_pd( b + i + 4 ) ) );
+            }
+            alignas( 32 ) double lanes[4];
+            _mm256_store_pd( lanes, _mm256_add_pd( acc0, acc1 ) );
+            r = ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] );
+#elif defined(__SSE2__)
+            __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+            for( ; i+4<=n; i+=4 ) {
+                acc0 = _mm_add_pd( acc0, _mm_mul_pd( _mm_loadu_pd( a + i ), _mm_loadu_pd( b + i ) ) );
+                acc1 = _mm_add_pd( acc1, _mm_mul_pd( _mm_loadu_pd( a + i + 2 ), _mm_loadu_pd( b + i + 2 ) ) );
+            }
+            alignas( 16 ) double lanes[2];
+            _mm_store_pd( lanes, _mm_add_pd( acc0, acc1 ) );
+            r = lanes[0] + lanes[1];
+#endif
+            for( ; i<n; ++i ) r += a[i] * b[i];
+
+            return r;
+        }
+
+        inline auto add( double const* const a, double const* const b, double* const out, std::size_t const n )
+            -> void
+        {
+            std::size_t i = 0;
+#if defined(__AVX__)
+            for( ; i+4<=n; i+=4 ) {
+                _mm256_storeu_pd( out + i, _mm256_add_pd( _mm256_loadu_pd( a + i ), _mm256_loadu_pd( b + i ) ) );
+            }
+#elif defined(__SSE2__)
+            for( ; i+2<=n; i+=2 ) {
+                _mm_storeu_pd( out + i, _mm_add_pd( _mm_loadu_pd( a + i ), _mm_loadu_pd( b + i ) ) );
+            }
+#endif
+            for( ; i<n; ++i ) out[i] = a[i] + b[i];
+        }
+
+        inline auto mul( double const* const a, double const* const b, double* const out, std::size_t const n )
+            -> void
+        {
+            std::size_t i = 0;
+#if defined(__AVX__)
+            for( ; i+4<=n; i+=4 ) {
+                _mm256_storeu_pd( out + i, _mm256_mul_pd( _mm256_loadu_pd( a + i ), _mm256_loadu_pd( b + i ) ) );
+            }
+#elif defined(__SSE2__)
+            for( ; i+2<=n; i+=2 ) {
+                _mm_storeu_pd( out + i, _mm_mul_pd( _mm_loadu_pd( a + i ), _mm_loadu_pd( b + i ) ) );
+            }
+#endif
+            for( ; i<n; ++i ) out[i] = a[i] * b[i];
+        }
+
+        inline auto scale( double const* const a, double const k, double* const out, std::size_t const n )
+            -> void
+        {
+            std::size_t i = 0;
+#if defined(__AVX__)
+            auto const vk = _mm256_set1_pd( k );
+            for( ; i+4<=n; i+=4 ) {
+                _mm256_storeu_pd( out + i, _mm256_mul_pd( _mm256_loadu_pd( a + i ), vk ) );
+            }
+#elif defined(__SSE2__)
+            auto const vk = _mm_set1_pd( k );
+            for( ; i+2<=n; i+=2 ) {
+                _mm_storeu_pd( out + i, _mm_mul_pd( _mm_loadu_pd( a + i ), vk ) );
+            }
+#endif
+            for( ; i<n; ++i ) out[i] = a[i] * k;
+        }
+
+        // n must be greater than 0
+        inline auto min( double const* const a, std::size_t const n )
+            -> double
+        {
+            std::size_t i = 0;
+            double r = a[0];
+#if defined(__AVX__)
+            if ( n >= 4 ) {
+                auto acc = _mm256_loadu_pd( a );
+                for( i=4; i+4<=n; i+=4 ) {
+                    acc = _mm256_min_pd( acc, _mm256_loadu_pd( a + i ) );
+                }
+                alignas( 32 ) double lanes[4];
+                _mm256_store_pd( lanes, acc );
+                r = std::min( std::min( lanes[0], lanes[1] ), std::min( lanes[2], lanes[3] ) );
+            }
+#elif defined(__SSE2__)
+            if ( n >= 2 ) {
+                auto acc = _mm_loadu_pd( a );
+                for( i=2; i+2<=n; i+=2 ) {
+                    acc = _mm_min_pd( acc, _mm_loadu_pd( a + i ) );
+                }
+                alignas( 16 ) double lanes[2];
+                _mm_store_pd( lanes, acc );
+                r = std::min( lanes[0], lanes[1] );
+            }
+#endif
+            for( ; i<n; ++i ) r = std::min( r, a[i] );
+
+            return r;
+        }
+
+        inline auto max( double const* const a, std::size_t const n )
+            -> double
+        {
+            std::size_t i = 0;
+            double r = a[0];
+#if defined(__AVX__)
+            if ( n >= 4 ) {
+                auto acc = _mm256_loadu_pd( a );
+                for( i=4; i+4<=n; i+=4 ) {
+                    acc = _mm256_max_pd( acc, _mm256_loadu_pd( a + i ) );
+                }
+                alignas( 32 ) double lanes[4];
+                _mm256_store_pd( lanes, acc );
+                r = std::max( std::max( lanes[0], lanes[1] ), std::max( lanes[2], lanes[3] ) );
+            }
+#elif defined(__SSE2__)
+            if ( n >= 2 ) {
+                auto acc = _mm_loadu_pd( a );
+                for( i=2; i+2<=n; i+=2 ) {
+                    acc = _mm_max_pd( acc, _mm_loadu_pd( a + i ) );
+                }
+                alignas( 16 ) double lanes[2];
+                _mm_store_pd( lanes, acc );
+                r = std::max( lanes[0], lanes[1] );
+            }
+#endif
+            for( ; i<n; ++i ) r = std::max( r, a[i] );
+
+            return r;
+        }
+
+
+        //
+        // int64. arithmetic wraps around as the element type does
+        //
+        inline auto sum( std::int64_t const* const a, std::size_t const n )
+            -> std::int64_t
+        {
+            std::size_t i = 0;
+            std::uint64_t r = 0;
+#if defined(__SSE2__)
+            __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+            for( ; i+4<=n; i+=4 ) {
+                acc0 = _mm_add_epi64( acc0, _mm_loadu_si128( reinterpret_cast<__m128i const*>( a + i ) ) );
+                acc1 = _mm_add_epi64( acc1, _mm_loadu_si128( reinterpret_cast<__m128i const*>( a + i + 2 ) ) );
+            }
+            alignas( 16 ) std::uint64_t lanes[2];
+            _mm_store_si128( reinterpret_cast<__m128i*>( lanes ), _mm_add_epi64( acc0, acc1 ) );
+            r = lanes[0] + lanes[1];
+#endif
+            for( ; i<n; ++i ) r += static_cast<std::uint64_t>( a[i] );
+
+            return static_cast<std::int64_t>( r );
+        }
+
+        // no packed 64bit multiplication before AVX-512. independent accumulators let the cpu overlap them
+        inline auto dot( std::int64_t const* const a, std::int64_t const* const b, std::size_t const n )
+            -> std::int64_t
+        {
+            std::size_t i = 0;
+            std::uint64_t r0 = 0, r1 = 0, r2 = 0, r3 = 0;
+            for( ; i+4<=n; i+=4 ) {
+                r0 += static_cast<std::uint64_t>( a[i] ) * static_cast<std::uint64_t>( b[i] );
+                r1 += static_cast<std::uint64_t>( a[i+1] ) * static_cast<std::uint64_t>( b[i+1] );
+                r2 += static_cast<std::uint64_t>( a[i+2] ) * static_cast<std::uint64_t>( b[i+2] );
+                r3 += static_cast<std::uint64_t>( a[i+3] ) * static_cast<std::uint64_t>( b[i+3] );
+            }
+            for( ; i<n; ++i ) r0 += static_cast<std::uint64_t>( a[i] ) * static_cast<std::uint64_t>( b[i] );
+
+            return static_cast<std::int64_t>( ( r0 + r1 ) + ( r2 + r3 ) );
+        }
+
+        inline auto add( std::int64_t const* const a, std::int64_t const* const b, std::int64_t* const out, std::size_t const n )
+            -> void
+        {
+            std::size_t i = 0;
+#if defined(__SSE2__)
+            for( ; i+2<=n; i+=2 ) {
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i*>( out + i ),
+                    _mm_add_epi64(
+                        _mm_loadu_si128( reinterpret_cast<__m128i const*>( a + i ) ),
+                        _mm_loadu_si128( reinterpret_cast<__m128i const*>( b + i ) )
+                        )
+                    );
+            }
+#endif
+            for( ; i<n; ++i ) out[i] = static_cast<std::int64_t>( static_cast<std::uint64_t>( a[i] ) + static_cast<std::uint64_t>( b[i] ) );
+        }
+
+        inline auto mul( std::int64_t const* const a, std::int64_t const* const b, std::int64_t* const out, std::size_t const n )
+            -> void
+        {
+            for( std::size_t i=0; i<n; ++i ) {
+                out[i] = static_cast<std::int64_t>( static_cast<std::uint64_t>( a[i] ) * static_cast<std::uint64_t>( b[i] ) );
+            }
+        }
+
+        inline auto scale( std::int64_t const* const a, std::int64_t const k, std::int64_t* const out, std::size_t const n )
+            -> void
+        {
+            for( std::size_t i=0; i<n; ++i ) {
+                out[i] = static_cast<std::int64_t>( static_cast<std::uint64_t>( a[i] ) * static_cast<std::uint64_t>( k ) );
+            }
+        }
+
+        // n must be greater than 0
+        inline auto min( std::int64_t const* const a, std::size_t const n )
+            -> std::int64_t
+        {
+            std::size_t i = 0;
+            std::int64_t r = a[0];
+#if defined(__SSE4_2__)
+            if ( n >= 2 ) {
+                auto acc = _mm_loadu_si128( reinterpret_cast<__m128i const*>( a ) );
+                for( i=2; i+2<=n; i+=2 ) {
+                    auto const v = _mm_loadu_si128( reinterpret_cast<__m128i const*>( a + i ) );
+                    acc = _mm_blendv_epi8( acc, v, _mm_cmpgt_epi64( acc, v ) );
+                }
+                alignas( 16 ) std::int64_t lanes[2];
+                _mm_store_si128( reinterpret_cast<__m128i*>( lanes ), acc );
+                r = std::min( lanes[0], lanes[1] );
+            }
+#endif
+            for( ; i<n; ++i ) r = std::min( r, a[i] );
+
+            return r;
+        }
+
+        inline auto max( std::int64_t const* const a, std::size_t const n )
+            -> std::int64_t
+        {
+            std::size_t i = 0;
+            std::int64_t r = a[0];
+#if defined(__SSE4_2__)
+            if ( n >= 2 ) {
+                auto acc = _mm_loadu_si128( reinterpret_cast<__m128i const*>( a ) );
+                for( i=2; i+2<=n; i+=2 ) {
+                    auto const v = _mm_loadu_si128( reinterpret_cast<__m128i const*>( a + i ) );
+                    acc = _mm_blendv_epi8( acc, v, _mm_cmpgt_epi64( v, acc ) );
+                }
+                alignas( 16 ) std::int64_t lanes[2];
+                _mm_store_si128( reinterpret_cast<__m128i*>( lanes ), acc );
+                r = std::max( lanes[0], lanes[1] );
+            }
+#endif
+            for( ; i<n; ++i ) r = std::max( r, a[i] );
+
+            return r;
+        }
+
+    } // namespace kernel
+} // namespace yakkai
@@ -1,5 +1,12 @@
 #include "printer.hpp"
 
+#include <limits>
+
+#include "../hash_table.hpp"
+#include "../pmap.hpp"
+#include "../bytevector.hpp"
+#include "../bytecode.hpp"
+
 
 namespace yakkai
 {
@@ -12,7 +19,10 @@ namespace yakkai
                 return os;
             }
 
-            if ( is_nil( n ) ) {
+            if ( is_fixnum( n ) ) {
+                os << fixnum_value( n ) << ": int";
+
+            } else if ( is_nil( n ) ) {
                 os << "(): unit";
 
             } else if ( n->type == node_type::e_list ) {
@@ -20,14 +30,14 @@ namespace yakkai
                 os << "( ";
                 auto c = static_cast<cons const* const>( n );
                 for(;;) {
-                    print_node_to_stream_with_type( os, c->car );
+                    print_node_to_stream_with_type( os, car( c ) );
                     os << " ";
-                    if ( is_nil( c->cdr ) ) {
+                    if ( is_nil( cdr( c ) ) ) {
                         break;
                     }
 
-                    assert( c->cdr->type == node_type::e_list );
-                    c = static_cast<cons const* const>( c->cdr );
+                    assert( type_of( cdr( c ) ) == node_type::e_list );
+                    c = static_cast<cons const* const>( cdr( c ) );
                 }
                 os << "): e_list";
 
@@ -35,13 +45,104 @@ namespace yakkai
                 auto s = static_cast<symbol const* const>( n );
                 os << s->value << ": symbol";
 
+            } else if ( n->type == node_type::e_string ) {
+                auto s = static_cast<string_value const* const>( n );
+                os << '"';
+                os.write( s->data(), s->length );
+                os << "\": string";
+
             } else if ( n->type == node_type::e_integer ) {
-                auto s = static_cast<integer_value const* const>( n );
-                os << s->value << ": int";
+                auto s = static_cast<bignum_value const* const>( n );
+                os << s->value.to_string() << ": int";
+
+            } else if ( n->type == node_type::e_ratio ) {
+                auto s = static_cast<ratio_value const* const>( n );
+                os << s->numerator.to_string() << "/" << s->denominator.to_string() << ": ratio";
 
             } else if ( n->type == node_type::e_float ) {
                 auto s = static_cast<float_value const* const>( n );
-                os << s->number << "e" << s->exp << ": float";
+                auto const precision = os.precision( std::numeric_limits<double>::digits10 );
+                os << s->value << ": float";
+                os.precision( precision );
+
+            } else if ( n->type == node_type::e_complex ) {
+                auto s = static_cast<complex_value const* const>( n );
+                auto const precision = os.precision( std::numeric_limits<double>::digits10 );
+                os << "#C(" << s->real << " " << s->imag << "): complex";
+                os.precision( precision );
+
+            } else if ( n->type == node_type::e_vector ) {
+                auto s = static_cast<vector_value const* const>( n );
+                os << "#( ";
+                for( auto&& e : s->elements ) {
+                    print_node_to_stream_with_type( os, e );
+                    os << " ";
+                }
+                os << "): vector";
+
+            } else if ( n->type == node_type::e_int64_array ) {
+                auto s = static_cast<int64_array_value const* const>( n );
+                os << "#i64( ";
+                for( auto&& v : s->values ) {
+                    os << v << " ";
+                }
+                os << "): int64-array";
+
+            } else if ( n->type == node_type::e_double_array ) {
+                auto s = static_cast<double_array_value const* const>( n );
+                auto const precision = os.precision( std::numeric_limits<double>::digits10 );
+                os << "#f64( ";
+                for( auto&& v : s->values ) {
+                    os << v << " ";
+                }
+                os << "): double-array";
+                os.precision( precision );
+
+            } else if ( n->type == node_type::e_hash_table ) {
+                auto s = static_cast<hash_table_value const* const>( n );
+                os << "#H( ";
+                s->for_each( [&os]( node const* const key, node const* const value ) {
+                        os << "( ";
+                        print_node_to_stream_with_type( os, key );
+                        os << " . ";
+                        print_node_to_stream_with_type( os, value );
+                        os << " ) ";
+                    } );
+                os << "): hash-table";
+
+            } else if ( n->type == node_type::e_pmap ) {
+                auto s = static_cast<pmap_value const* const>( n );
+                os << "#M( ";
+                s->for_each( [&os]( node const* const key, node const* const value ) {
+                        os << "( ";
+                        print_node_to_stream_with_type( os, key );
+                        os << " . ";
+                        print_node_to_stream_with_type( os, value );
+                        os << " ) ";
+                    } );
+                os << "): pmap";
+
+            } else if ( n->type == node_type::e_bytevector ) {
+                // contents may be huge, show the head of them
+                std::size_t const shown_max = 16;
+
+                auto s = static_cast<bytevector_value const* const>( n );
+                os << "#u8( ";
+                for( std::size_t i=0; i<s->size() && i<shown_max; ++i ) {
+                    os << static_cast<unsigned int>( s->data()[i] ) << " ";
+                }
+                if ( s->size() > shown_max ) {
+                    os << "... (" << s->size() << " bytes) ";
+                }
+                os << "): bytevector";
+
+            } else if ( n->type == node_type::e_function ) {
+                // same as lambda forms which are not compiled
+                print_node_to_stream_with_type( os, static_cast<function_value const* const>( n )->code->source );
+
+            } else if ( n->type == node_type::e_macro ) {
+                os << "#macro";
+                print_node_to_stream_with_type( os, static_cast<macro_value const* const>( n )->expander );
 
             } else {
                 os << debug_string( n->type ) << " : !!Unknown!!";